@@ -1,4 +1,17 @@
 #include "ContrastFix.h"
+#include "AsyncPnm.h"
+#include "Autotune.h"
+#include "Batch.h"
+#include "Bench.h"
+#include "FrameStream.h"
+#include "MappedPnm.h"
+#include "Pnm.h"
+#include "Profile.h"
+#include "Sampling.h"
+#include "TiledPnm.h"
+#include <omp.h>
+
+#include <cstdlib>
 #include <iostream>
 
 int main(int argc, char** argv) {
@@ -29,11 +42,67 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (!args.profile.empty()) {
+        profile_start();
+    }
+
+    if (args.bench) {
+        return run_bench(args) ? 0 : 1;
+    }
+
+    if (args.frames) {
+        return process_frames(args) ? 0 : 1;
+    }
+
+    if (!args.batch_dir.empty()) {
+        return process_batch(args) ? 0 : 1;
+    }
+
+    if (args.use_mmap || args.tile_mb > 0) {
+        int used_threads = 1;
+        double ms = 0.0;
+        bool ok = args.use_mmap ? process_mapped_pnm(args, used_threads, ms)
+                                : process_tiled_pnm(args, used_threads, ms);
+        if (!ok) {
+            return 1;
+        }
+        std::printf("Time (%i threads): %lg\n", used_threads, ms);
+        return args.profile.empty() || write_profile(args.profile) ? 0 : 1;
+    }
+
+    if (!args.async_io.empty()) {
+        int used_threads = 1;
+        double ms = 0.0;
+        double wall_ms = 0.0;
+        const char* backend = "";
+        if (!process_async_pnm(args, used_threads, ms, wall_ms, backend)) {
+            return 1;
+        }
+        std::printf("Time (%i threads): %lg\n", used_threads, ms);
+        std::printf("Wall time (%s): %lg\n", backend, wall_ms);
+        return args.profile.empty() || write_profile(args.profile) ? 0 : 1;
+    }
+
+    double w0 = omp_get_wtime();
+
     Image img;
-    if (!read_pnm(args.in_path, img)){
+    bool read_ok;
+    {
+        PhaseScope scope(Phase::Read);
+        read_ok = read_pnm(args.in_path, img);
+    }
+    if (!read_ok) {
         return 1;
     }
 
+    if (args.autotune) {
+        double tune0 = omp_get_wtime();
+        TunedConfig cfg;
+        bool cached = false;
+        autotune(args, img, cfg, cached);
+        print_tuned(cfg, cached, (omp_get_wtime() - tune0) * 1000.0);
+    }
+
     double t0 = omp_get_wtime();
 
     int used_threads = 1;
@@ -45,20 +114,46 @@ int main(int argc, char** argv) {
                 used_threads = omp_get_num_threads();
             }
         }
-        StretchParams sp = calc_params_omp(img, args.coef);
+    }
+
+    StretchParams sp;
+    SampledParams est;
+    if (args.sample < 1.0) {
+        est = calc_params_sampled(view_of(img), args.coef, args.sample, args.is_omp, args.per_channel);
+        sp = est.sp;
+        if (args.refine) {
+            sp = calc_params(view_of(img), args.coef, args.is_omp, args.per_channel);
+        }
+    } else if (args.is_omp) {
+        sp = calc_params_omp(img, args.coef, args.per_channel);
+    } else {
+        sp = calc_params_no_omp(img, args.coef, args.per_channel);
+    }
+
+    if (args.is_omp) {
         stretch_omp(img, sp);
     } else {
-        used_threads = 1;
-        StretchParams sp = calc_params_no_omp(img, args.coef);
         stretch_no_omp(img, sp);
     }
 
     double t1 = omp_get_wtime();
     double ms = (t1 - t0) * 1000.0;
 
-    if(!write_pnm(args.out_path, img)){
+    bool write_ok;
+    {
+        PhaseScope scope(Phase::Write);
+        write_ok = write_pnm(args.out_path, img);
+    }
+    if (!write_ok) {
         return 1;
     }
+    if (args.sample < 1.0) {
+        print_sampled(est, img.alpha ? img.channels - 1 : img.channels, args.refine ? &sp : nullptr);
+    }
     std::printf("Time (%i threads): %lg\n", used_threads, ms);
-    return 0;
+    if (args.wall_time) {
+        // Для сравнения с --async-io: полное время вместе с чтением и записью.
+        std::printf("Wall time (sync): %lg\n", (omp_get_wtime() - w0) * 1000.0);
+    }
+    return args.profile.empty() || write_profile(args.profile) ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "AsyncIo.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define CF_HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Потоков в переносимой реализации: чтение и запись соседних чанков
+// идут одновременно, больше для одного файла обычно не нужно.
+constexpr unsigned kIoThreads = 2;
+
+// Переносимая реализация: пул потоков, выполняющих pread/pwrite.
+class ThreadQueue final : public IoQueue {
+public:
+    ThreadQueue() {
+        for (unsigned i = 0; i < kIoThreads; ++i) workers_.emplace_back([this] { run(); });
+    }
+
+    ~ThreadQueue() override {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            closed_ = true;
+        }
+        has_work_.notify_all();
+        for (auto& t : workers_) t.join();
+    }
+
+    const char* name() const override { return "threads"; }
+
+    bool submit(const IoRequest& r) override {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            todo_.push_back(r);
+            ++pending_;
+        }
+        has_work_.notify_one();
+        return true;
+    }
+
+    bool wait(IoCompletion& c) override {
+        std::unique_lock<std::mutex> lk(m_);
+        if (pending_ == 0) return false;
+        has_done_.wait(lk, [&] { return !done_.empty(); });
+        c = done_.front();
+        done_.pop_front();
+        --pending_;
+        return true;
+    }
+
+private:
+    void run() {
+        for (;;) {
+            IoRequest r;
+            {
+                std::unique_lock<std::mutex> lk(m_);
+                has_work_.wait(lk, [&] { return closed_ || !todo_.empty(); });
+                if (todo_.empty()) return;
+                r = todo_.front();
+                todo_.pop_front();
+            }
+            ssize_t n;
+            do {
+                n = r.write ? pwrite(r.fd, r.buf, r.len, r.off) : pread(r.fd, r.buf, r.len, r.off);
+            } while (n < 0 && errno == EINTR);
+            IoCompletion c;
+            c.tag = r.tag;
+            c.res = n < 0 ? -errno : static_cast<long>(n);
+            {
+                std::lock_guard<std::mutex> lk(m_);
+                done_.push_back(c);
+            }
+            has_done_.notify_one();
+        }
+    }
+
+    std::mutex m_;
+    std::condition_variable has_work_;
+    std::condition_variable has_done_;
+    std::deque<IoRequest> todo_;
+    std::deque<IoCompletion> done_;
+    size_t pending_ = 0;
+    bool closed_ = false;
+    std::vector<std::thread> workers_;
+};
+
+#ifdef CF_HAVE_URING
+
+// io_uring через системные вызовы, без liburing: кольца SQ/CQ отображаются
+// в память, одна операция — один SQE, ожидание — io_uring_enter(GETEVENTS).
+class UringQueue final : public IoQueue {
+public:
+    ~UringQueue() override {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) munmap(sq_ptr_, sq_size_);
+        if (fd_ >= 0) close(fd_);
+    }
+
+    bool init(unsigned depth) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, depth, &p));
+        if (fd_ < 0) return false;
+        // IORING_OP_READ / WRITE появились в том же ядре (5.6), что и этот флаг.
+        if (!(p.features & IORING_FEAT_RW_CUR_POS)) return false;
+
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+        sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+        if (!sq_ptr_) return false;
+        cq_ptr_ = single ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+        if (!cq_ptr_) return false;
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) return false;
+
+        auto* sq = static_cast<std::uint8_t*>(sq_ptr_);
+        auto* cq = static_cast<std::uint8_t*>(cq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        return true;
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    bool submit(const IoRequest& r) override {
+        // SQ заполняет только этот поток, ядро лишь читает tail.
+        unsigned tail = *sq_tail_;
+        unsigned idx = tail & sq_mask_;
+        io_uring_sqe* e = &sqes_[idx];
+        std::memset(e, 0, sizeof(*e));
+        e->opcode = r.write ? IORING_OP_WRITE : IORING_OP_READ;
+        e->fd = r.fd;
+        e->addr = reinterpret_cast<std::uint64_t>(r.buf);
+        e->len = static_cast<std::uint32_t>(r.len);
+        e->off = static_cast<std::uint64_t>(r.off);
+        e->user_data = r.tag;
+        sq_array_[idx] = idx;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+        long n;
+        do {
+            n = syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n < 1 && __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) == tail) {
+            // Ядро SQE не забрало: снимаем его, иначе его подхватит следующий enter.
+            __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+            return false;
+        }
+        ++pending_;  // SQE принят ядром, завершение придёт и при ошибке enter
+        return true;
+    }
+
+    bool wait(IoCompletion& c) override {
+        if (pending_ == 0) return false;
+        for (;;) {
+            unsigned head = *cq_head_;
+            if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& e = cqes_[head & cq_mask_];
+                c.tag = e.user_data;
+                c.res = e.res;
+                __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+                --pending_;
+                return true;
+            }
+            long n = syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (n < 0 && errno != EINTR) return false;
+        }
+    }
+
+private:
+    void* map(size_t size, off_t what) {
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, what);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    int fd_ = -1;
+    void* sq_ptr_ = nullptr;
+    void* cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    size_t pending_ = 0;
+};
+
+#endif
+
+}  // namespace
+
+std::unique_ptr<IoQueue> make_io_queue(const std::string& kind, unsigned depth) {
+    if (kind != "threads") {
+#ifdef CF_HAVE_URING
+        auto q = std::make_unique<UringQueue>();
+        if (q->init(depth)) return q;
+#endif
+        if (kind == "uring") {
+            std::fprintf(stderr, "io_uring is not available.\n");
+            return nullptr;
+        }
+    }
+    return std::make_unique<ThreadQueue>();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/types.h>
+
+// Очередь асинхронных операций pread/pwrite над дескрипторами.
+// Завершения приходят в произвольном порядке; короткое чтение или запись
+// не дочитывается — это делает вызывающий код по res.
+struct IoRequest {
+    bool write = false;
+    int fd = -1;
+    std::uint8_t* buf = nullptr;
+    size_t len = 0;
+    off_t off = 0;
+    std::uint64_t tag = 0;
+};
+
+struct IoCompletion {
+    std::uint64_t tag = 0;
+    long res = 0;  // число байт или -errno
+};
+
+class IoQueue {
+public:
+    virtual ~IoQueue() = default;
+
+    virtual const char* name() const = 0;
+
+    // Не больше depth операций одновременно (depth задаётся при создании).
+    virtual bool submit(const IoRequest& r) = 0;
+    // Ждёт одно завершение; false — нет незавершённых операций.
+    virtual bool wait(IoCompletion& c) = 0;
+};
+
+// kind: "auto" (io_uring, если ядро его поддерживает, иначе потоки),
+// "uring" или "threads". nullptr — выбранный вариант недоступен.
+std::unique_ptr<IoQueue> make_io_queue(const std::string& kind, unsigned depth);
@@ -0,0 +1,262 @@
+#include "AsyncPnm.h"
+#include "AsyncIo.h"
+#include "Partition.h"
+#include "Pnm.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kHeaderProbe = 4096;
+
+// Чанк крупнее блока ядра, чтобы параллельная гистограмма и растяжение
+// внутри чанка не тонули в накладных расходах; kDepth чанков в полёте.
+constexpr size_t kChunkBytes = size_t(4) << 20;
+constexpr unsigned kDepth = 8;
+
+struct Fd {
+    int fd = -1;
+    ~Fd() { if (fd >= 0) close(fd); }
+};
+
+// Часть тела файла; done — сколько байт уже прочитано (или записано).
+struct Chunk {
+    size_t begin = 0;
+    size_t len = 0;
+    size_t done = 0;
+};
+
+bool pread_full(int fd, std::uint8_t* buf, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t r = pread(fd, buf, n, off);
+        if (r <= 0) return false;
+        buf += r;
+        n -= static_cast<size_t>(r);
+        off += r;
+    }
+    return true;
+}
+
+// Запросы одной стадии (чтения или записи) над чанками буфера data.
+// Короткие операции дозапускаются с того места, где остановились.
+class ChunkIo {
+public:
+    ChunkIo(IoQueue& q, std::vector<Chunk>& chunks, std::uint8_t* data)
+        : q_(q), chunks_(chunks), data_(data) {}
+
+    ~ChunkIo() { drain(); }
+
+    void start(bool write, int fd, size_t base) {
+        write_ = write;
+        fd_ = fd;
+        base_ = base;
+        for (auto& ch : chunks_) ch.done = 0;
+    }
+
+    unsigned in_flight() const { return in_flight_; }
+
+    bool submit(size_t k) {
+        const Chunk& ch = chunks_[k];
+        IoRequest r;
+        r.write = write_;
+        r.fd = fd_;
+        r.buf = data_ + ch.begin + ch.done;
+        r.len = ch.len - ch.done;
+        r.off = static_cast<off_t>(base_ + ch.begin + ch.done);
+        r.tag = k;
+        if (!q_.submit(r)) return false;
+        ++in_flight_;
+        return true;
+    }
+
+    // Ждёт, пока какой-нибудь чанк не будет обработан целиком; k — его номер.
+    bool wait(size_t& k) {
+        for (;;) {
+            IoCompletion c;
+            if (!q_.wait(c)) return false;
+            --in_flight_;
+            if (c.res <= 0) return false;
+            Chunk& ch = chunks_[c.tag];
+            ch.done += static_cast<size_t>(c.res);
+            if (ch.done == ch.len) {
+                k = c.tag;
+                return true;
+            }
+            if (!submit(c.tag)) return false;
+        }
+    }
+
+    // Буфер нельзя освобождать, пока ядро или поток в него пишет.
+    void drain() {
+        IoCompletion c;
+        while (in_flight_ > 0 && q_.wait(c)) --in_flight_;
+    }
+
+private:
+    IoQueue& q_;
+    std::vector<Chunk>& chunks_;
+    std::uint8_t* data_;
+    bool write_ = false;
+    int fd_ = -1;
+    size_t base_ = 0;
+    unsigned in_flight_ = 0;
+};
+
+}  // namespace
+
+bool process_async_pnm(Args& a, int& used_threads, double& ms, double& wall_ms, const char*& backend) {
+    double w0 = omp_get_wtime();
+
+    Fd in;
+    in.fd = open(a.in_path.c_str(), O_RDONLY);
+    if (in.fd < 0) {
+        std::fprintf(stderr, "Cannot open: %s\n", a.in_path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(in.fd, &st) != 0) {
+        std::fprintf(stderr, "Cannot stat: %s\n", a.in_path.c_str());
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(st.st_size);
+
+    std::uint8_t probe[kHeaderProbe];
+    size_t probe_len = std::min(file_size, kHeaderProbe);
+    if (!pread_full(in.fd, probe, probe_len, 0)) {
+        std::fprintf(stderr, "Cannot read header.\n");
+        return false;
+    }
+
+    Image img;
+    size_t offset = 0;
+    if (!parse_pnm_header(probe, probe_len, img, offset)) {
+        return false;
+    }
+    if (img.format == PnmFormat::Ascii) {
+        std::fprintf(stderr, "--async-io needs binary PNM (P5, P6, P7).\n");
+        return false;
+    }
+
+    const int C = img.channels;
+    const size_t px = static_cast<size_t>(C) * sample_bytes(img.maxval);
+    const size_t N = static_cast<size_t>(img.width) * img.height;
+    const size_t body = N * px;
+    if (file_size - offset < body) {
+        std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+        return false;
+    }
+
+    img.data.resize(body);
+    first_touch(img.data.data(), N, px);
+
+    // Чанк — целое число пикселей.
+    const size_t chunk = std::max<size_t>(1, kChunkBytes / px) * px;
+    std::vector<Chunk> chunks((body + chunk - 1) / chunk);
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        chunks[k].begin = k * chunk;
+        chunks[k].len = std::min(chunk, body - k * chunk);
+    }
+
+    // Выход заранее получает итоговый размер: записи чанков не удлиняют файл
+    // и могут идти в любом порядке.
+    std::string header = pnm_header(img);
+    Fd out;
+    out.fd = open(a.out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out.fd < 0 || ftruncate(out.fd, static_cast<off_t>(header.size() + body)) != 0 ||
+        pwrite(out.fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size())) {
+        std::fprintf(stderr, "Cannot write output file: %s\n", a.out_path.c_str());
+        return false;
+    }
+
+    std::unique_ptr<IoQueue> queue = make_io_queue(a.async_io, kDepth);
+    if (!queue) {
+        return false;
+    }
+    backend = queue->name();
+    ChunkIo io(*queue, chunks, img.data.data());
+
+    used_threads = 1;
+    if (a.is_omp) {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                used_threads = omp_get_num_threads();
+            }
+        }
+    }
+
+    double kernel = 0.0;
+
+    // Проход 1: чтения в полёте, гистограмма — по чанкам в порядке готовности.
+    ChannelHist hist;
+    io.start(false, in.fd, offset);
+    size_t next = 0;
+    for (size_t left = chunks.size(); left > 0; --left) {
+        while (io.in_flight() < kDepth && next < chunks.size()) {
+            if (!io.submit(next++)) {
+                std::fprintf(stderr, "Async read failed.\n");
+                return false;
+            }
+        }
+        size_t k = 0;
+        if (!io.wait(k)) {
+            std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+            return false;
+        }
+
+        double t0 = omp_get_wtime();
+        const std::uint8_t* p = img.data.data() + chunks[k].begin;
+        if (a.is_omp) {
+            histogram_add_omp(p, chunks[k].len / px, C, img.maxval, hist);
+        } else {
+            histogram_add_no_omp(p, chunks[k].len / px, C, img.maxval, hist);
+        }
+        kernel += omp_get_wtime() - t0;
+    }
+
+    double t0 = omp_get_wtime();
+    StretchParams sp = params_from_hist(hist, C, a.coef, img.maxval, a.per_channel, img.alpha);
+    kernel += omp_get_wtime() - t0;
+
+    // Проход 2: чанк k растягивается, пока записываются предыдущие.
+    io.start(true, out.fd, header.size());
+    for (size_t k = 0; k < chunks.size(); ++k) {
+        double t1 = omp_get_wtime();
+        std::uint8_t* p = img.data.data() + chunks[k].begin;
+        if (a.is_omp) {
+            stretch_omp(p, p, chunks[k].len / px, C, sp);
+        } else {
+            stretch_no_omp(p, p, chunks[k].len / px, C, sp);
+        }
+        kernel += omp_get_wtime() - t1;
+
+        size_t done = 0;
+        bool ok = (io.in_flight() < kDepth || io.wait(done)) && io.submit(k);
+        if (!ok) {
+            std::fprintf(stderr, "Async write failed.\n");
+            return false;
+        }
+    }
+    while (io.in_flight() > 0) {
+        size_t done = 0;
+        if (!io.wait(done)) {
+            std::fprintf(stderr, "Async write failed.\n");
+            return false;
+        }
+    }
+
+    ms = kernel * 1000.0;
+    wall_ms = (omp_get_wtime() - w0) * 1000.0;
+    return true;
+}
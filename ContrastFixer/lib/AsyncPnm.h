@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+// Обработка с перекрытием ввода-вывода и вычислений (--async-io): тело файла
+// читается чанками, до нескольких запросов в очереди одновременно, и гистограмма
+// строится по каждому чанку, как только он прочитан. Затем чанки растягиваются
+// по порядку, и запись каждого уходит в очередь, пока растягиваются следующие.
+// Очередь — io_uring или пул потоков с pread/pwrite (см. AsyncIo.h).
+// ms — время вычислений, wall_ms — полное время от открытия входа до конца
+// записи, backend — имя использованной очереди.
+bool process_async_pnm(Args& a, int& used_threads, double& ms, double& wall_ms, const char*& backend);
@@ -0,0 +1,210 @@
+#include "Autotune.h"
+#include "Partition.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// Калибровка идёт не больше чем на стольких байтах изображения (первые строки):
+// на больших изображениях разбиение уже не зависит от размера, а время прогона — да.
+constexpr size_t kTrialBytes = size_t(64) << 20;
+constexpr int kTrialWarmup = 1;
+constexpr int kTrialReps = 3;
+
+// Чанки для dynamic; static с явным чанком по benches.csv не выигрывает у подбора (0).
+constexpr int kDynamicChunks[] = { 0, 4096, 65536 };
+
+std::string cpu_model() {
+    std::ifstream f("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.compare(0, 10, "model name") != 0) continue;
+        size_t p = line.find(':');
+        if (p == std::string::npos) break;
+        size_t b = line.find_first_not_of(" \t", p + 1);
+        std::string m = b == std::string::npos ? std::string() : line.substr(b);
+        std::replace(m.begin(), m.end(), '\t', ' ');
+        return m.empty() ? "unknown" : m;
+    }
+    return "unknown";
+}
+
+int size_class(size_t bytes) {
+    int k = 0;
+    while (bytes > 1) {
+        bytes >>= 1;
+        ++k;
+    }
+    return k;
+}
+
+// Ключ — первые четыре поля строки кэша, через табуляцию.
+std::string cache_key(const Image& img) {
+    size_t px = static_cast<size_t>(img.channels) * sample_bytes(img.maxval);
+    size_t bytes = static_cast<size_t>(img.width) * img.height * px;
+    return cpu_model() + "\t" + std::to_string(omp_get_num_procs()) + "\t" +
+           std::to_string(size_class(bytes)) + "\t" + std::to_string(img.channels);
+}
+
+// Строка кэша: ключ, затем "seq" | "omp", потоки, static | dynamic, чанк, время.
+std::string format_entry(const std::string& key, const TunedConfig& c) {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "\t%s\t%d\t%s\t%d\t%.4f", c.omp ? "omp" : "seq", c.threads,
+                  c.dynamic ? "dynamic" : "static", c.chunk, c.ms);
+    return key + buf;
+}
+
+bool load_entry(const std::string& path, const std::string& key, TunedConfig& c) {
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.size() <= key.size() || line.compare(0, key.size(), key) != 0 || line[key.size()] != '\t') {
+            continue;
+        }
+        std::istringstream ss(line.substr(key.size() + 1));
+        std::string mode, sched;
+        TunedConfig t;
+        if (!(ss >> mode >> t.threads >> sched >> t.chunk >> t.ms) || t.threads <= 0 || t.chunk < 0) {
+            continue;
+        }
+        t.omp = mode == "omp";
+        t.dynamic = sched == "dynamic";
+        c = t;
+        return true;
+    }
+    return false;
+}
+
+// Старая запись с тем же ключом заменяется; файл переписывается через rename.
+bool store_entry(const std::string& path, const std::string& key, const TunedConfig& c) {
+    std::vector<std::string> lines;
+    {
+        std::ifstream f(path);
+        std::string line;
+        while (std::getline(f, line)) {
+            bool same = line.size() > key.size() && line.compare(0, key.size(), key) == 0 && line[key.size()] == '\t';
+            if (!same && !line.empty()) lines.push_back(line);
+        }
+    }
+    lines.push_back(format_entry(key, c));
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        for (const auto& l : lines) f << l << '\n';
+        if (!f) {
+            std::fprintf(stderr, "Cannot write autotune cache: %s\n", tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::fprintf(stderr, "Cannot write autotune cache: %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void apply(Args& a, const TunedConfig& c) {
+    a.is_omp = c.omp;
+    a.threads_default = false;
+    a.threads = c.threads;
+    a.schedule_kind = c.dynamic ? "dynamic" : "static";
+    a.chunk_size = c.chunk;
+    if (c.omp) {
+        omp_set_num_threads(c.threads);
+        omp_set_schedule(c.dynamic ? omp_sched_dynamic : omp_sched_static, c.chunk);
+    }
+}
+
+// Лучшее время гистограммы и растяжения N пикселей src в dst.
+double trial(const Image& img, size_t N, PixelBuffer& dst, const Args& a, bool omp) {
+    const std::uint8_t* src = img.data.data();
+    const int C = img.channels;
+    double best = 0.0;
+    for (int r = 0; r < kTrialWarmup + kTrialReps; ++r) {
+        double t0 = omp_get_wtime();
+        if (omp) {
+            StretchParams sp = calc_params_omp(src, N, C, img.maxval, a.coef, a.per_channel, img.alpha);
+            stretch_omp(src, dst.data(), N, C, sp);
+        } else {
+            StretchParams sp = calc_params_no_omp(src, N, C, img.maxval, a.coef, a.per_channel, img.alpha);
+            stretch_no_omp(src, dst.data(), N, C, sp);
+        }
+        double ms = (omp_get_wtime() - t0) * 1000.0;
+        if (r >= kTrialWarmup && (r == kTrialWarmup || ms < best)) best = ms;
+    }
+    return best;
+}
+
+TunedConfig calibrate(const Args& a, const Image& img) {
+    const size_t px = static_cast<size_t>(img.channels) * sample_bytes(img.maxval);
+    const size_t row = static_cast<size_t>(img.width) * px;
+    const size_t rows = std::min<size_t>(img.height, std::max<size_t>(1, kTrialBytes / std::max<size_t>(row, 1)));
+    const size_t N = rows * img.width;
+
+    PixelBuffer dst(N * px);
+    first_touch(dst.data(), N, px);
+
+    std::vector<TunedConfig> grid;
+    grid.push_back(TunedConfig{});
+    std::vector<int> threads;
+    int procs = omp_get_num_procs();
+    for (int t = 1; t < procs; t *= 2) threads.push_back(t);
+    threads.push_back(procs);
+    for (int t : threads) {
+        TunedConfig c;
+        c.omp = true;
+        c.threads = t;
+        grid.push_back(c);
+        c.dynamic = true;
+        for (int chunk : kDynamicChunks) {
+            c.chunk = chunk;
+            grid.push_back(c);
+        }
+    }
+
+    TunedConfig best;
+    bool have = false;
+    for (TunedConfig& c : grid) {
+        Args tmp = a;
+        apply(tmp, c);
+        c.ms = trial(img, N, dst, a, c.omp);
+        if (!have || c.ms < best.ms) {
+            best = c;
+            have = true;
+        }
+    }
+    return best;
+}
+
+}  // namespace
+
+void autotune(Args& a, const Image& img, TunedConfig& cfg, bool& cached) {
+    std::string key = cache_key(img);
+    cached = load_entry(a.tune_cache, key, cfg);
+    if (!cached) {
+        cfg = calibrate(a, img);
+        // Без кэша обработка всё равно идёт, просто следующий запуск откалибрует заново.
+        store_entry(a.tune_cache, key, cfg);
+    }
+    apply(a, cfg);
+}
+
+void print_tuned(const TunedConfig& cfg, bool cached, double calib_ms) {
+    if (!cfg.omp) {
+        std::printf("Autotune: --no-omp");
+    } else {
+        std::printf("Autotune: --omp-threads %d --schedule %s --chunk_size %d", cfg.threads,
+                    cfg.dynamic ? "dynamic" : "static", cfg.chunk);
+    }
+    if (cached) {
+        std::printf(" (cached)\n");
+    } else {
+        std::printf(" (calibrated in %lg ms)\n", calib_ms);
+    }
+}
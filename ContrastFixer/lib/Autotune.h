@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <string>
+
+// Конфигурация ядер: последовательно либо OpenMP с числом потоков,
+// планированием и размером чанка (0 — подбирается по изображению).
+struct TunedConfig {
+    bool omp = false;
+    int threads = 1;
+    bool dynamic = false;
+    int chunk = 0;
+    double ms = 0.0;  // лучшее время гистограмма + растяжение на калибровке
+};
+
+// Автоподбор (--autotune): короткие прогоны гистограммы и растяжения на самом
+// изображении (для больших — на его первых строках) по сетке
+// потоки x планирование x чанк, выбирается самый быстрый вариант.
+// Результат кэшируется в a.tune_cache по ключу (модель CPU, число процессоров,
+// класс размера — log2 байт изображения, число каналов), и следующие запуски
+// с тем же ключом калибровку не повторяют. Выбранная конфигурация применяется:
+// a.is_omp, omp_set_num_threads, omp_set_schedule.
+// cached — конфигурация взята из кэша.
+void autotune(Args& a, const Image& img, TunedConfig& cfg, bool& cached);
+
+void print_tuned(const TunedConfig& cfg, bool cached, double calib_ms);
@@ -0,0 +1,214 @@
+#include "Batch.h"
+#include "Pnm.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Изображения меньше этого размера выгоднее обрабатывать целиком в одном потоке
+// (см. small-in в assets/benches.csv), а параллелить — между изображениями.
+constexpr size_t kIntraImageBytes = size_t(8) << 20;
+
+// Ограничение на объём изображений, ожидающих в очереди между стадиями.
+constexpr size_t kMaxQueuedBytes = size_t(512) << 20;
+
+struct Job {
+    std::string in_path;
+    std::string out_path;
+    std::string name;
+    Image img;
+    bool ok = true;
+    double read_ms = 0.0;
+    double compute_ms = 0.0;
+    double write_ms = 0.0;
+
+    size_t bytes() const { return img.data.size(); }
+};
+
+using JobPtr = std::unique_ptr<Job>;
+
+// Ограниченная по числу элементов и по байтам очередь между стадиями.
+class JobQueue {
+public:
+    explicit JobQueue(size_t max_items) : max_items_(max_items) {}
+
+    void push(JobPtr j) {
+        std::unique_lock<std::mutex> lk(m_);
+        not_full_.wait(lk, [&] {
+            return q_.empty() || (q_.size() < max_items_ && bytes_ + j->bytes() <= kMaxQueuedBytes);
+        });
+        bytes_ += j->bytes();
+        q_.push_back(std::move(j));
+        not_empty_.notify_one();
+    }
+
+    // nullptr — очередь закрыта и пуста.
+    JobPtr pop() {
+        std::unique_lock<std::mutex> lk(m_);
+        not_empty_.wait(lk, [&] { return !q_.empty() || closed_; });
+        return take();
+    }
+
+    // Без ожидания; nullptr, если очередь пуста.
+    JobPtr try_pop_small() {
+        std::lock_guard<std::mutex> lk(m_);
+        if (q_.empty() || q_.front()->bytes() >= kIntraImageBytes) return nullptr;
+        return take();
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lk(m_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    JobPtr take() {
+        if (q_.empty()) return nullptr;
+        JobPtr j = std::move(q_.front());
+        q_.pop_front();
+        bytes_ -= j->bytes();
+        not_full_.notify_all();
+        return j;
+    }
+
+    size_t max_items_;
+    size_t bytes_ = 0;
+    bool closed_ = false;
+    std::deque<JobPtr> q_;
+    std::mutex m_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+};
+
+bool is_pnm_file(const fs::path& p) {
+    std::string ext = p.extension().string();
+    return ext == ".pnm" || ext == ".pgm" || ext == ".ppm" || ext == ".pam";
+}
+
+double mb_per_s(size_t bytes, double ms) {
+    return ms > 0.0 ? (bytes / double(1 << 20)) / (ms / 1000.0) : 0.0;
+}
+
+void compute_one(Job& j, bool intra_omp, double coef, bool per_channel) {
+    double t0 = omp_get_wtime();
+    if (intra_omp) {
+        StretchParams sp = calc_params_omp(j.img, coef, per_channel);
+        stretch_omp(j.img, sp);
+    } else {
+        StretchParams sp = calc_params_no_omp(j.img, coef, per_channel);
+        stretch_no_omp(j.img, sp);
+    }
+    j.compute_ms = (omp_get_wtime() - t0) * 1000.0;
+}
+
+}  // namespace
+
+bool process_batch(Args& a) {
+    std::error_code ec;
+    std::vector<fs::path> files;
+    for (auto& e : fs::directory_iterator(a.batch_dir, ec)) {
+        if (e.is_regular_file() && is_pnm_file(e.path())) files.push_back(e.path());
+    }
+    if (ec) {
+        std::fprintf(stderr, "Cannot read directory: %s\n", a.batch_dir.c_str());
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+
+    fs::create_directories(a.out_dir, ec);
+    if (ec) {
+        std::fprintf(stderr, "Cannot create directory: %s\n", a.out_dir.c_str());
+        return false;
+    }
+
+    int nthreads = a.is_omp ? omp_get_max_threads() : 1;
+    JobQueue to_compute(static_cast<size_t>(nthreads) + 1);
+    JobQueue to_write(static_cast<size_t>(nthreads) + 1);
+
+    double t0 = omp_get_wtime();
+
+    std::thread reader([&] {
+        for (auto& f : files) {
+            auto j = std::make_unique<Job>();
+            j->in_path = f.string();
+            j->name = f.filename().string();
+            j->out_path = (fs::path(a.out_dir) / f.filename()).string();
+
+            double r0 = omp_get_wtime();
+            j->ok = read_pnm(j->in_path, j->img);
+            j->read_ms = (omp_get_wtime() - r0) * 1000.0;
+            to_compute.push(std::move(j));
+        }
+        to_compute.close();
+    });
+
+    size_t total_bytes = 0;
+    int failed = 0;
+
+    std::thread writer([&] {
+        while (JobPtr j = to_write.pop()) {
+            if (j->ok) {
+                double w0 = omp_get_wtime();
+                j->ok = write_pnm(j->out_path, j->img);
+                j->write_ms = (omp_get_wtime() - w0) * 1000.0;
+            }
+
+            if (!j->ok) {
+                ++failed;
+                std::printf("%s: FAILED\n", j->name.c_str());
+                continue;
+            }
+            total_bytes += j->bytes();
+            std::printf("%s: %.2f MB, read %.2f ms, compute %.2f ms (%.1f MB/s), write %.2f ms\n",
+                        j->name.c_str(), j->bytes() / double(1 << 20), j->read_ms,
+                        j->compute_ms, mb_per_s(j->bytes(), j->compute_ms), j->write_ms);
+        }
+    });
+
+    // Обработка: большое изображение — все потоки на одно изображение,
+    // небольшие — набираются в группу и делятся между потоками целиком.
+    while (JobPtr j = to_compute.pop()) {
+        if (!j->ok || !a.is_omp || j->bytes() >= kIntraImageBytes) {
+            if (j->ok) compute_one(*j, a.is_omp, a.coef, a.per_channel);
+            to_write.push(std::move(j));
+            continue;
+        }
+
+        std::vector<JobPtr> group;
+        group.push_back(std::move(j));
+        while (static_cast<int>(group.size()) < nthreads) {
+            JobPtr next = to_compute.try_pop_small();
+            if (!next) break;
+            group.push_back(std::move(next));
+        }
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(group.size()); ++i) {
+            if (group[i]->ok) compute_one(*group[i], false, a.coef, a.per_channel);
+        }
+
+        for (auto& g : group) to_write.push(std::move(g));
+    }
+
+    reader.join();
+    to_write.close();
+    writer.join();
+
+    double wall_ms = (omp_get_wtime() - t0) * 1000.0;
+    std::printf("Total: %zu files (%d failed), %.2f MB, %.2f ms, %.1f MB/s (%i threads)\n",
+                files.size(), failed, total_bytes / double(1 << 20), wall_ms,
+                mb_per_s(total_bytes, wall_ms), nthreads);
+
+    return failed == 0;
+}
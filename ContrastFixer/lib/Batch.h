@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+// Пакетная обработка всех PNM-файлов каталога a.batch_dir в a.out_dir.
+// Три стадии работают одновременно: чтение файла N+1, обработка N, запись N-1.
+// Большие изображения обрабатываются параллельно внутри (ядра *_omp),
+// небольшие — группами, по одному изображению на поток.
+// Печатает пропускную способность по каждому файлу и итоговую.
+bool process_batch(Args& a);
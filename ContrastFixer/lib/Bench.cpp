@@ -0,0 +1,185 @@
+#include "Bench.h"
+#include "Partition.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace {
+
+struct BenchSize {
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+};
+
+struct PhaseStats {
+    double best = 0.0;
+    double avg = 0.0;
+    double p95 = 0.0;
+};
+
+struct BenchRow {
+    PhaseStats hist;
+    PhaseStats stretch;
+    PhaseStats total;
+};
+
+bool parse_int_list(const std::string& s, std::vector<int>& out) {
+    out.clear();
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char* end = nullptr;
+        long v = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || !end || *end != '\0' || v < 0) return false;
+        out.push_back(static_cast<int>(v));
+    }
+    return !out.empty();
+}
+
+// "WxH" или "WxHxC" через запятую, C = 1 или 3.
+bool parse_sizes(const std::string& s, std::vector<BenchSize>& out) {
+    out.clear();
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        BenchSize b;
+        int n = std::sscanf(item.c_str(), "%dx%dx%d", &b.width, &b.height, &b.channels);
+        if (n < 2 || b.width <= 0 || b.height <= 0 || (b.channels != 1 && b.channels != 3)) return false;
+        out.push_back(b);
+    }
+    return !out.empty();
+}
+
+// Детерминированное изображение с узким диапазоном яркостей и плавным градиентом,
+// чтобы растяжение было нетривиальным и одинаковым между запусками.
+void make_synthetic(const BenchSize& b, Image& img) {
+    img.width = b.width;
+    img.height = b.height;
+    img.channels = b.channels;
+    img.data.resize(static_cast<size_t>(b.width) * b.height * b.channels);
+    first_touch(img.data.data(), img.data.size() / b.channels, b.channels);
+
+    std::uint32_t x = 2463534242u;
+    for (size_t i = 0; i < img.data.size(); ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        size_t row = i / (static_cast<size_t>(b.width) * b.channels);
+        img.data[i] = static_cast<std::uint8_t>(40 + (row * 64) / b.height + (x % 96));
+    }
+}
+
+PhaseStats summarize(std::vector<double> v) {
+    PhaseStats s;
+    std::sort(v.begin(), v.end());
+    s.best = v.front();
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    s.avg = sum / v.size();
+    size_t k = (v.size() * 95 + 99) / 100;
+    s.p95 = v[std::min(v.size(), std::max<size_t>(k, 1)) - 1];
+    return s;
+}
+
+BenchRow measure(const Image& img, PixelBuffer& dst, bool omp, double coef, int warmup, int reps) {
+    const size_t N = static_cast<size_t>(img.width) * img.height;
+    const int C = img.channels;
+    const std::uint8_t* src = img.data.data();
+
+    std::vector<double> th, ts, tt;
+    for (int r = 0; r < warmup + reps; ++r) {
+        double t0 = omp_get_wtime();
+        StretchParams sp = omp ? calc_params_omp(src, N, C, img.maxval, coef)
+                                 : calc_params_no_omp(src, N, C, img.maxval, coef);
+        double t1 = omp_get_wtime();
+        if (omp) {
+            stretch_omp(src, dst.data(), N, C, sp);
+        } else {
+            stretch_no_omp(src, dst.data(), N, C, sp);
+        }
+        double t2 = omp_get_wtime();
+
+        if (r < warmup) continue;
+        th.push_back((t1 - t0) * 1000.0);
+        ts.push_back((t2 - t1) * 1000.0);
+        tt.push_back((t2 - t0) * 1000.0);
+    }
+
+    return { summarize(th), summarize(ts), summarize(tt) };
+}
+
+void print_row(std::FILE* f, const std::string& dataset, const std::string& label, const char* sched,
+               int threads, int chunk, const BenchRow& r, const char* note, const BenchRow& base) {
+    std::fprintf(f, "%s,%s,%s,%d,%d,%.5g,%.5g,%s,%.5g,%.5g,%.5g,%.5g,%.5g,%.5g,%.5g,%.5g,%.5g\n",
+                 dataset.c_str(), label.c_str(), sched, threads, chunk,
+                 r.total.best, r.total.avg, note,
+                 base.total.best / r.total.best, base.total.avg / r.total.avg,
+                 r.total.p95,
+                 r.hist.best, r.hist.avg, r.hist.p95,
+                 r.stretch.best, r.stretch.avg, r.stretch.p95);
+    std::fflush(f);
+}
+
+}  // namespace
+
+bool run_bench(Args& a) {
+    std::vector<BenchSize> sizes;
+    std::vector<int> threads;
+    std::vector<int> chunks;
+    if (!parse_sizes(a.bench_sizes, sizes)) {
+        std::fprintf(stderr, "Bad --bench-sizes (WxH[xC],...).\n");
+        return false;
+    }
+    if (!parse_int_list(a.bench_threads, threads) || !parse_int_list(a.bench_chunks, chunks)) {
+        std::fprintf(stderr, "Bad --bench-threads / --bench-chunks list.\n");
+        return false;
+    }
+
+    std::FILE* f = stdout;
+    if (!a.bench_out.empty()) {
+        f = std::fopen(a.bench_out.c_str(), "w");
+        if (!f) {
+            std::fprintf(stderr, "Cannot open output file: %s\n", a.bench_out.c_str());
+            return false;
+        }
+    }
+
+    std::fprintf(f, "dataset,dataset_label,schedule,threads,chunk,time_best_ms,time_avg_ms,note,"
+                    "speedup_best,speedup_avg,time_p95_ms,hist_best_ms,hist_avg_ms,hist_p95_ms,"
+                    "stretch_best_ms,stretch_avg_ms,stretch_p95_ms\n");
+
+    for (const BenchSize& b : sizes) {
+        Image img;
+        make_synthetic(b, img);
+        PixelBuffer dst(img.data.size());
+        first_touch(dst.data(), img.data.size() / b.channels, b.channels);
+
+        std::string dataset = "synthetic_" + std::to_string(b.width) + "x" + std::to_string(b.height) +
+                              (b.channels == 3 ? "_P6" : "_P5");
+        std::string label = std::to_string(b.width) + "x" + std::to_string(b.height) + "x" +
+                            std::to_string(b.channels);
+
+        BenchRow base = measure(img, dst, false, a.coef, a.bench_warmup, a.bench_reps);
+        print_row(f, dataset, label, "seq", 1, 0, base, "baseline", base);
+
+        for (const char* sched : { "static", "dynamic" }) {
+            omp_sched_t kind = std::string(sched) == "dynamic" ? omp_sched_dynamic : omp_sched_static;
+            for (int t : threads) {
+                if (t <= 0) continue;
+                for (int chunk : chunks) {
+                    omp_set_num_threads(t);
+                    omp_set_schedule(kind, chunk);
+                    BenchRow r = measure(img, dst, true, a.coef, a.bench_warmup, a.bench_reps);
+                    print_row(f, dataset, label, sched, t, chunk, r, "", base);
+                }
+            }
+        }
+    }
+
+    if (f != stdout) std::fclose(f);
+    return true;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+// Воспроизводимый замер ядер на синтетических изображениях.
+// Для каждого размера из a.bench_sizes: последовательный прогон (baseline) и
+// перебор потоков x планирования x размера чанка; a.bench_warmup разогревочных
+// и a.bench_reps измеряемых повторов. Фазы гистограммы и растяжения замеряются
+// отдельно. CSV совпадает по первым столбцам с assets/benches.csv.
+bool run_bench(Args& a);
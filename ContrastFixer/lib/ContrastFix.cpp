@@ -1,31 +1,85 @@
 #include "ContrastFix.h"
+#include "Histogram.h"
+#include "Kernels.h"
+#include "Partition.h"
+#include "StretchLut.h"
 #include <omp.h>
 
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
-#include <fstream>
+#include <cstring>
 
 void print_help(char* argv0) {
     std::printf(
 R"(Использование:
   %s [--help] \
-    --input <fname> \
-    --output <fname> \
+    --input <fname> --output <fname> | --batch <dir> --out-dir <dir> \
     --no-omp | --omp-threads <num_threads | default> \
-    --coef <float, [0.0,0.5)> \
+    --coef <float, [0.0,0.5)> [--per-channel] [--sample <rate> [--refine]] \
     --schedule <static / dynamic> \
-    --chunk_size <0 or higher>
+    --chunk_size <0 or higher> \
+    [--mmap | --tile-mb <MB> | --async-io <auto / uring / threads>] [--wall-time] \
+    [--profile <fname | ->] [--autotune [--autotune-cache <fname>]]
 
 OpenMP:
     --no-omp: последовательная реализация
     --omp-threads default: распараллеливание, число потоков по умолчанию 8
     --omp-threads N: распараллеливание, N > 0 потоков
     --schedule <static / dynamic>: вид планирования
-    --chunk_size <int> = 0: 0 — по умолчанию; > 0 — явный размер чанка
+    --chunk_size <int> = 0: 0 — размер блока подбирается по размеру изображения
+            и числу потоков; > 0 — явный размер блока в пикселях
+    --autotune: потоки, планирование и чанк выбираются короткими прогонами на
+            самом изображении (вместо трёх флагов выше); результат кэшируется
+            по модели CPU, классу размера изображения и числу каналов
+    --autotune-cache <fname>: файл кэша, по умолчанию contrastfixer.tune
+
+Оценка порогов:
+    --sample <rate, (0.0,1.0]>: пороги по выборке из доли rate пикселей
+            (полосы строк, в каждой — блоки по 64 пикселя); печатается
+            интервал, в который точные пороги попадают с вероятностью 95%%
+    --refine: после оценки посчитать точные пороги и вывести расхождение
+
+Ввод-вывод:
+    --batch <dir> --out-dir <dir>: обработать все .pnm/.pgm/.ppm/.pam файлы каталога;
+            чтение, обработка и запись соседних файлов идут одновременно
+    --frames: вход — последовательность изображений PNM/PAM подряд (видео),
+            "-" — stdin/stdout;
+            чтение следующего кадра и запись предыдущего совмещены с обработкой
+    --smooth <alpha, [0.0,1.0]>: экспоненциальное сглаживание порогов между
+            кадрами (0 — пороги каждого кадра независимы)
+    --mmap: входной и выходной файлы отображаются в память, гистограмма
+            строится прямо по отображению, результат пишется сразу в выходной файл
+    --tile-mb <MB>: изображение обрабатывается полосами в пределах заданного
+            бюджета памяти (для файлов больше ОЗУ); чтение и запись полос идут
+            параллельно с вычислениями
+    --async-io <auto / uring / threads>: тело файла читается чанками через
+            очередь асинхронных запросов (io_uring или потоки с pread/pwrite),
+            гистограмма строится по мере чтения, запись растянутых чанков идёт,
+            пока растягиваются следующие; печатается и полное время с вводом-выводом
+    --wall-time: то же полное время (Wall time (sync)) для обычного ввода-вывода,
+            чтобы сравнить его с --async-io
+
+Замеры:
+    --profile <fname | ->: JSON-отчёт по фазам read, histogram, merge, stretch,
+            write для каждого потока: время и счётчики perf_event_open (cycles,
+            instructions, llc_misses, branch_misses); без доступа к perf — только время
+    --bench: замер на синтетических изображениях вместо обработки файла
+    --bench-sizes <WxH[xC],...>: размеры (C = 1 или 3), по умолчанию 1024x768x1,1024x768x3,8192x8192x1
+    --bench-threads <list>: число потоков, по умолчанию 1,2,4,8,16
+    --bench-chunks <list>: размеры чанка, по умолчанию 0,1,64,256,1024,2048
+    --bench-warmup <N> = 2, --bench-reps <N> = 10: разогрев и число повторов
+    --bench-out <fname>: CSV-файл (по умолчанию stdout), столбцы как в assets/benches.csv
+            плюс time_p95_ms и best/avg/p95 для фаз гистограммы и растяжения
 
 Описание:
-Поддерживаются форматы P5 (Gray) и P6 (RGB).
+Поддерживаются форматы P5/P2 (Gray) и P6/P3 (RGB), двоичные и текстовые,
+и PAM (P7) с альфа-каналом или без; 8 и 16 бит (maxval до 65535). Результат
+пишется в том же формате, альфа-канал не изменяется. Комментарии '#' в
+заголовке допускаются. --mmap, --tile-mb и --async-io работают только с двоичными
+форматами.
+По умолчанию для RGB пороги общие для трёх каналов; --per-channel считает
+их для каждого канала отдельно.
 В процессе выполнения увеличивается контрастность.
 )",
         argv0, SCHEDULE_CHUNK_SIZE
@@ -76,6 +130,74 @@ bool parse_args(int argc, char** argv, Args& a) {
                 std::fprintf(stderr, "Unknown --schedule.\n");
                 return false;
             }
+        } else if (s == "--batch" && i + 1 < argc) {
+            a.batch_dir = argv[++i];
+        } else if (s == "--out-dir" && i + 1 < argc) {
+            a.out_dir = argv[++i];
+        } else if (s == "--bench") {
+            a.bench = true;
+        } else if (s == "--bench-sizes" && i + 1 < argc) {
+            a.bench_sizes = argv[++i];
+        } else if (s == "--bench-threads" && i + 1 < argc) {
+            a.bench_threads = argv[++i];
+        } else if (s == "--bench-chunks" && i + 1 < argc) {
+            a.bench_chunks = argv[++i];
+        } else if ((s == "--bench-warmup" || s == "--bench-reps") && i + 1 < argc) {
+            char* end = nullptr;
+            long v = std::strtol(argv[++i], &end, 10);
+            if (!end || *end != '\0' || v < 0 || (s == "--bench-reps" && v == 0)) {
+                std::fprintf(stderr, "Bad %s value.\n", s.c_str());
+                return false;
+            }
+            (s == "--bench-reps" ? a.bench_reps : a.bench_warmup) = static_cast<int>(v);
+        } else if (s == "--bench-out" && i + 1 < argc) {
+            a.bench_out = argv[++i];
+        } else if (s == "--frames") {
+            a.frames = true;
+        } else if (s == "--smooth" && i + 1 < argc) {
+            char* end = nullptr;
+            double v = std::strtod(argv[++i], &end);
+            if (!end || *end != '\0' || v < 0 || v > 1) {
+                std::fprintf(stderr, "Bad --smooth value [0.0, 1.0].\n");
+                return false;
+            }
+            a.smooth = v;
+        } else if (s == "--sample" && i + 1 < argc) {
+            char* end = nullptr;
+            double v = std::strtod(argv[++i], &end);
+            if (!end || *end != '\0' || v <= 0 || v > 1) {
+                std::fprintf(stderr, "Bad --sample value (0.0, 1.0].\n");
+                return false;
+            }
+            a.sample = v;
+        } else if (s == "--refine") {
+            a.refine = true;
+        } else if (s == "--per-channel") {
+            a.per_channel = true;
+        } else if (s == "--mmap") {
+            a.use_mmap = true;
+        } else if (s == "--tile-mb" && i + 1 < argc) {
+            char* end = nullptr;
+            long long v = std::strtoll(argv[++i], &end, 10);
+            if (!end || *end != '\0' || v <= 0) {
+                std::fprintf(stderr, "Bad --tile-mb (> 0).\n");
+                return false;
+            }
+            a.tile_mb = static_cast<size_t>(v);
+        } else if (s == "--autotune") {
+            a.autotune = true;
+        } else if (s == "--autotune-cache" && i + 1 < argc) {
+            a.tune_cache = argv[++i];
+        } else if (s == "--wall-time") {
+            a.wall_time = true;
+        } else if (s == "--profile" && i + 1 < argc) {
+            a.profile = argv[++i];
+        } else if (s == "--async-io" && i + 1 < argc) {
+            a.async_io = argv[++i];
+            if (a.async_io != "auto" && a.async_io != "uring" && a.async_io != "threads") {
+                std::fprintf(stderr, "Unknown --async-io (auto / uring / threads).\n");
+                return false;
+            }
         } else if (s == "--chunk_size" && i + 1 < argc) {
             char* end = nullptr;
             int v = static_cast<int>(std::strtoll(argv[++i], &end, 10));
@@ -90,123 +212,99 @@ bool parse_args(int argc, char** argv, Args& a) {
         }
     }
 
-    if (a.in_path.empty() || a.out_path.empty()) {
+    if (a.bench) {
+        return true;
+    }
+
+    if (!a.batch_dir.empty() || !a.out_dir.empty()) {
+        if (a.batch_dir.empty() || a.out_dir.empty()) {
+            std::fprintf(stderr, "Need both --batch and --out-dir.\n");
+            return false;
+        }
+    } else if (a.in_path.empty() || a.out_path.empty()) {
         std::fprintf(stderr, "Need --input and --output.\n");
         return false;
     }
 
-    return true;
-}
-
-bool read_pnm(std::string& path, Image& img) {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) {
-        std::fprintf(stderr, "Cannot open: %s\n", path.c_str());
+    if (a.use_mmap && a.tile_mb > 0) {
+        std::fprintf(stderr, "--mmap and --tile-mb are mutually exclusive.\n");
         return false;
     }
 
-    std::string magic;
-    int maxv = 0;
-
-    f >> magic;
-    f >> img.width >> img.height >> maxv;
-
-    if (maxv != 255) {
-        std::fprintf(stderr, "Bad max value.\n");
+    if (a.autotune && (a.frames || !a.batch_dir.empty() || a.use_mmap || a.tile_mb > 0 || !a.async_io.empty())) {
+        std::fprintf(stderr, "--autotune works only with --input / --output.\n");
         return false;
     }
 
-    img.channels = (magic == "P6") ? 3 : 1;
-
-    int c = f.get();
-    if (c == '\r' && f.peek() == '\n') {
-        f.get();
+    if (!a.profile.empty() && (a.frames || !a.batch_dir.empty())) {
+        std::fprintf(stderr, "--profile works only with --input / --output.\n");
+        return false;
     }
-    if (c == EOF) {
-        std::fprintf(stderr, "Unexpected EOF after header.\n");
+
+    if (!a.async_io.empty() && (a.use_mmap || a.tile_mb > 0 || a.frames || !a.batch_dir.empty() || a.sample < 1.0)) {
+        std::fprintf(stderr, "--async-io works only with --input / --output, without --mmap / --tile-mb / --sample.\n");
         return false;
     }
 
-    size_t size = img.width * img.height * img.channels;
-    img.data.resize(size);
+    if (a.sample < 1.0 && (a.frames || a.use_mmap || a.tile_mb > 0 || !a.batch_dir.empty())) {
+        std::fprintf(stderr, "--sample works only with --input / --output.\n");
+        return false;
+    }
 
-    f.read(reinterpret_cast<char*>(img.data.data()), size);
-    if (static_cast<size_t>(f.gcount()) != size) {
-        std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+    if (a.frames && (a.use_mmap || a.tile_mb > 0)) {
+        std::fprintf(stderr, "--frames works with streams, not with --mmap / --tile-mb.\n");
         return false;
     }
 
     return true;
 }
 
-bool write_pnm(std::string& path, Image& img) {
-    std::ofstream f(path, std::ios::binary);
-    if (!f) {
-        std::fprintf(stderr, "Cannot open output file: %s\n", path.c_str());
-        return false;
-    }
+// Ищет нижний и верхний пороги, отбросив долю coef самых тёмных и самых светлых значений.
+static void find_bounds(const uint64_t* h, int maxval, double coef, int& lower, int& higher) {
+    uint64_t total = 0;
+    for (int v = 0; v <= maxval; ++v) total += h[v];
 
-    if (img.channels == 1) {
-        f << "P5\n" << img.width << " " << img.height << "\n255\n";
-    } else {
-        f << "P6\n" << img.width << " " << img.height << "\n255\n";
-    }
+    uint64_t skip = std::floor(coef * total);
 
-    f.write(reinterpret_cast<char*>(img.data.data()), img.data.size());
-    return static_cast<bool>(f);
-}
+    uint64_t cnt = 0;
+    lower = 0;
+    for (int v = 0; v <= maxval; ++v) {
+        if (cnt + h[v] > skip) {
+            lower = v;
+            break;
+        }
+        cnt += h[v];
+    }
 
-StretchParams calc_params_no_omp(Image& img, double coef) {
-    int C = img.channels;
-    size_t N = img.width * img.height;
-
-    std::vector<std::array<uint32_t, 256>> hist(C);
-    for (auto& h : hist) h.fill(0);
-
-    if (C == 1) {
-        for (size_t i = 0; i < N; ++i) hist[0][img.data[i]]++;
-    } else {
-        uint8_t* p = img.data.data();
-        for (size_t i = 0; i < N; ++i) {
-            hist[0][p[0]]++;
-            hist[1][p[1]]++;
-            hist[2][p[2]]++;
-            p += 3;
+    cnt = 0;
+    higher = maxval;
+    for (int v = maxval; v >= 0; --v) {
+        if (cnt + h[v] > skip) {
+            higher = v;
+            break;
         }
+        cnt += h[v];
     }
+}
 
+StretchParams params_from_hist(const ChannelHist& hist, int C, double coef, int maxval, bool per_channel,
+                               bool alpha) {
     StretchParams sp;
+    sp.maxval = maxval;
 
-    if (C == 3) {
-        std::array<uint64_t, 256> all{};
-        for (int v = 0; v < 256; ++v) {
+    const int colors = alpha ? C - 1 : C;
+    if (alpha) sp.is_const[colors] = true;
+
+    if (colors == 3 && !per_channel) {
+        // Общие пороги по объединённой гистограмме трёх каналов.
+        std::vector<uint64_t> all(hist[0].size());
+        for (size_t v = 0; v < all.size(); ++v) {
             all[v] = hist[0][v] + hist[1][v] + hist[2][v];
         }
 
-        uint64_t total = 0;
-        for (uint64_t x : all) total += x;
-
-        uint64_t skip = std::floor(coef * total);
-
-        uint64_t cnt = 0;
         int lower = 0;
-        for (int v = 0; v < 256; ++v) {
-            if (cnt + all[v] > skip) {
-                lower = v;
-                break;
-            }
-            cnt += all[v];
-        }
-
-        cnt = 0;
-        int higher = 255;
-        for (int v = 255; v >= 0; --v) {
-            if (cnt + all[v] > skip) {
-                higher = v;
-                break;
-            }
-            cnt += all[v];
-        }
+        int higher = maxval;
+        find_bounds(all.data(), maxval, coef, lower, higher);
 
         bool eq = lower >= higher;
         for (int c = 0; c < 3; ++c) {
@@ -218,32 +316,11 @@ StretchParams calc_params_no_omp(Image& img, double coef) {
         return sp;
     }
 
-    // Grayscale
-    for (int c = 0; c < C; ++c) {
-        uint64_t total = 0;
-        for (uint32_t x : hist[c]) total += x;
-
-        uint64_t skip = std::floor(coef * total);
-
-        uint64_t cnt = 0;
+    // Grayscale или независимые каналы
+    for (int c = 0; c < colors; ++c) {
         int lower = 0;
-        for (int v = 0; v < 256; ++v) {
-            if (cnt + hist[c][v] > skip) {
-                lower = v;
-                break;
-            }
-            cnt += hist[c][v];
-        }
-
-        cnt = 0;
-        int higher = 255;
-        for (int v = 255; v >= 0; --v) {
-            if (cnt + hist[c][v] > skip) {
-                higher = v;
-                break;
-            }
-            cnt += hist[c][v];
-        }
+        int higher = maxval;
+        find_bounds(hist[c].data(), maxval, coef, lower, higher);
 
         sp.lower[c] = lower;
         sp.higher[c] = higher;
@@ -253,201 +330,151 @@ StretchParams calc_params_no_omp(Image& img, double coef) {
     return sp;
 }
 
-StretchParams calc_params_omp(Image& img, double coef) {
-    int C = img.channels;
-    size_t N = img.width * img.height;
-
-    int nthreads = 1;
-    #pragma omp parallel
-    {
-        #pragma omp single
-        nthreads = omp_get_num_threads();
-    }
+namespace {
 
-    std::vector<std::vector<std::array<uint32_t, 256>>> local(
-        nthreads, std::vector<std::array<uint32_t, 256>>(C)
-    );
-    for (auto& v : local)
-        for (auto& arr : v)
-            arr.fill(0);
-
-    if (C == 1) {
-        #pragma omp parallel for schedule(runtime)
-        for (ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(N); ++i) {
-            int tid = omp_get_thread_num();
-            uint8_t v = img.data[i];
-            local[tid][0][v]++;
-        }
-    } else {
-        #pragma omp parallel for schedule(runtime)
-        for (ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(N); ++i) {
-            int tid = omp_get_thread_num();
-            uint8_t* p = &img.data[i * 3];
-            local[tid][0][p[0]]++;
-            local[tid][1][p[1]]++;
-            local[tid][2][p[2]]++;
+// Пиксель целиком: каналы-константы копируются, остальные идут через таблицу.
+template <class S, int C, unsigned Mask, int c = 0>
+inline void map_pixel(const typename S::Value* const* t, const uint8_t* s, uint8_t* d) {
+    if constexpr (c < C) {
+        if constexpr (((Mask >> c) & 1u) != 0) {
+            for (int b = 0; b < S::bytes; ++b) d[b] = s[b];
+        } else {
+            S::store(d, t[c][S::load(s)]);
         }
+        map_pixel<S, C, Mask, c + 1>(t, s + S::bytes, d + S::bytes);
     }
+}
 
-    std::vector<std::array<uint32_t, 256>> hist(C);
-    for (auto& a : hist) a.fill(0);
-
-    for (int t = 0; t < nthreads; ++t)
-        for (int c = 0; c < C; ++c)
-            for (int v = 0; v < 256; ++v)
-                hist[c][v] += local[t][c][v];
+template <class S, int C, unsigned Mask>
+void map_pixels(const typename S::Value* const* t, const uint8_t* src, uint8_t* dst, size_t n) {
+    constexpr size_t px = static_cast<size_t>(C) * S::bytes;
+    // Локальная копия указателей: запись байтов в dst не заставляет перечитывать их из t.
+    const typename S::Value* tc[C];
+    for (int c = 0; c < C; ++c) tc[c] = t[c];
+    for (size_t i = 0; i < n; ++i) {
+        map_pixel<S, C, Mask>(tc, src + i * px, dst + i * px);
+    }
+}
 
-    StretchParams sp;
+// Вызывает row(s, d, n) для кусков строк: одна строка делится по пикселям,
+// несколько — по строкам.
+template <class Policy, class Row>
+void for_rows(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+              size_t width, size_t height, size_t px, Row&& row) {
+    if (height == 1) {
+        Partition p = Policy::plan(width, px);
+        run_partition(p, [&](int, size_t first, size_t count) {
+            row(src + first * px, dst + first * px, count);
+        }, Phase::Stretch);
+        return;
+    }
 
-    if (C == 3) {
-        std::array<uint64_t, 256> all{};
-        for (int v = 0; v < 256; ++v) {
-            all[v] =
-                hist[0][v] +
-                hist[1][v] +
-                hist[2][v];
+    Partition p = Policy::plan(height, width * px, width);
+    run_partition(p, [&](int, size_t first, size_t count) {
+        for (size_t y = first; y < first + count; ++y) {
+            row(src + y * src_stride, dst + y * dst_stride, width);
         }
+    }, Phase::Stretch);
+}
 
-        uint64_t total = 0;
-        for (uint64_t x : all) total += x;
+}  // namespace
 
-        uint64_t skip = std::floor(coef * total);
+template <class Policy>
+StretchParams calc_params_impl(const uint8_t* data, size_t width, size_t height, size_t stride,
+                               int C, int maxval, double coef, bool per_channel, bool alpha) {
+    ChannelHist hist;
+    histogram_add_rows_impl<Policy>(data, width, height, stride, C, maxval, hist);
+    return params_from_hist(hist, C, coef, maxval, per_channel, alpha);
+}
 
-        uint64_t cnt = 0;
-        int lower = 0;
-        for (int v = 0; v < 256; ++v) {
-            if (cnt + all[v] > skip) {
-                lower = v;
-                break;
-            }
-            cnt += all[v];
+template <class Policy>
+void stretch_rows_impl(const uint8_t* src, size_t src_stride, uint8_t* dst, size_t dst_stride,
+                       size_t width, size_t height, int C, const StretchParams& sp) {
+    const unsigned mask = const_mask(sp, C);
+
+    dispatch_format(C, sp.maxval, [&](auto sample, auto channels) {
+        using S = decltype(sample);
+        constexpr int Ch = decltype(channels)::value;
+        constexpr size_t px = static_cast<size_t>(Ch) * S::bytes;
+
+        auto rows = [&](auto&& row) {
+            for_rows<Policy>(src, src_stride, dst, dst_stride, width, height, px, row);
+        };
+
+        if (mask == full_mask(Ch)) {
+            // Ни один канал не растягивается.
+            if (src == dst && src_stride == dst_stride) return;
+            rows([](const uint8_t* s, uint8_t* d, size_t n) { std::memmove(d, s, n * px); });
+            return;
         }
 
-        cnt = 0;
-        int higher = 255;
-        for (int v = 255; v >= 0; --v) {
-            if (cnt + all[v] > skip) {
-                higher = v;
-                break;
+        const typename S::Value* t[kMaxChannels] = {};
+        StretchLut lut;
+        StretchLut16 lut16;
+        if constexpr (S::bytes == 1) {
+            lut = build_lut(sp, Ch);
+            if (lut.shared) {
+                // Одна таблица на все байты — векторный поиск.
+                rows([&](const uint8_t* s, uint8_t* d, size_t n) { apply_lut(lut, s, d, n); });
+                return;
             }
-            cnt += all[v];
-        }
-
-        bool eq = lower >= higher;
-        for (int c = 0; c < 3; ++c) {
-            sp.lower[c] = lower;
-            sp.higher[c] = higher;
-            sp.is_const[c] = eq;
+            for (int c = 0; c < Ch; ++c) t[c] = lut.table[c].data();
+        } else {
+            lut16 = build_lut16(sp, Ch);
+            for (int c = 0; c < Ch; ++c) t[c] = lut16.table[c].data();
         }
 
-        return sp;
-    }
-
-    // grayscale
-    for (int c = 0; c < C; ++c) {
-        uint64_t total = 0;
-        for (uint32_t x : hist[c]) total += x;
-
-        uint64_t skip = std::floor(coef * total);
+        dispatch_mask<Ch>(mask, [&](auto m) {
+            rows([&](const uint8_t* s, uint8_t* d, size_t n) {
+                map_pixels<S, Ch, decltype(m)::value>(t, s, d, n);
+            });
+        });
+    });
+}
 
-        uint64_t cnt = 0;
-        int lower = 0;
-        for (int v = 0; v < 256; ++v) {
-            if (cnt + hist[c][v] > skip) {
-                lower = v;
-                break;
-            }
-            cnt += hist[c][v];
-        }
+template StretchParams calc_params_impl<Sequential>(const uint8_t*, size_t, size_t, size_t, int, int, double, bool,
+                                                   bool);
+template StretchParams calc_params_impl<Parallel>(const uint8_t*, size_t, size_t, size_t, int, int, double, bool,
+                                                 bool);
+template void stretch_rows_impl<Sequential>(const uint8_t*, size_t, uint8_t*, size_t, size_t, size_t, int,
+                                            const StretchParams&);
+template void stretch_rows_impl<Parallel>(const uint8_t*, size_t, uint8_t*, size_t, size_t, size_t, int,
+                                          const StretchParams&);
+
+StretchParams calc_params_no_omp(const uint8_t* data, size_t N, int C, int maxval, double coef, bool per_channel,
+                                 bool alpha) {
+    return calc_params_impl<Sequential>(data, N, 1, 0, C, maxval, coef, per_channel, alpha);
+}
 
-        cnt = 0;
-        int higher = 255;
-        for (int v = 255; v >= 0; --v) {
-            if (cnt + hist[c][v] > skip) {
-                higher = v;
-                break;
-            }
-            cnt += hist[c][v];
-        }
+StretchParams calc_params_omp(const uint8_t* data, size_t N, int C, int maxval, double coef, bool per_channel,
+                              bool alpha) {
+    return calc_params_impl<Parallel>(data, N, 1, 0, C, maxval, coef, per_channel, alpha);
+}
 
-        sp.lower[c] = lower;
-        sp.higher[c] = higher;
-        sp.is_const[c] = lower >= higher;
-    }
+StretchParams calc_params_no_omp(const Image& img, double coef, bool per_channel) {
+    size_t N = static_cast<size_t>(img.width) * img.height;
+    return calc_params_no_omp(img.data.data(), N, img.channels, img.maxval, coef, per_channel, img.alpha);
+}
 
-    return sp;
+StretchParams calc_params_omp(const Image& img, double coef, bool per_channel) {
+    size_t N = static_cast<size_t>(img.width) * img.height;
+    return calc_params_omp(img.data.data(), N, img.channels, img.maxval, coef, per_channel, img.alpha);
 }
 
-void stretch_no_omp(Image& img, StretchParams& sp) {
-    int C = img.channels;
-    size_t N = img.width * img.height;
-
-    std::array<double, 3> scale{};
-    for (int c = 0; c < C; ++c)
-        if (!sp.is_const[c])
-            scale[c] = 255.0 / (sp.higher[c] - sp.lower[c]);
-
-    if (C == 1) {
-        bool is_const = sp.is_const[0];
-        int lower = sp.lower[0];
-        double sc = scale[0];
-
-        for (size_t i = 0; i < N; ++i) {
-            if (!is_const) {
-                int temp = std::lround((img.data[i] - lower) * sc);
-                temp = (temp < 0 ? 0 : (temp > 255 ? 255 : temp));
-                img.data[i] = static_cast<uint8_t>(temp);
-            }
-        }
-        return;
-    }
+void stretch_no_omp(const uint8_t* src, uint8_t* dst, size_t N, int C, const StretchParams& sp) {
+    stretch_rows_impl<Sequential>(src, 0, dst, 0, N, 1, C, sp);
+}
 
-    // RGB
-    uint8_t* p = img.data.data();
-    for (size_t i = 0; i < N; ++i) {
-        for (int c = 0; c < 3; ++c) {
-            if (!sp.is_const[c]) {
-                int temp = std::lround((p[c] - sp.lower[c]) * scale[c]);
-                p[c] = static_cast<uint8_t>(temp < 0 ? 0 : (temp > 255 ? 255 : temp));
-            }
-        }
-        p += 3;
-    }
+void stretch_omp(const uint8_t* src, uint8_t* dst, size_t N, int C, const StretchParams& sp) {
+    stretch_rows_impl<Parallel>(src, 0, dst, 0, N, 1, C, sp);
 }
 
-void stretch_omp(Image& img, StretchParams& sp) {
-    int C = img.channels;
-    size_t N = img.width * img.height;
-
-    std::array<double, 3> scale{};
-    for (int c = 0; c < C; ++c)
-        if (!sp.is_const[c])
-            scale[c] = 255.0 / (sp.higher[c] - sp.lower[c]);
-
-    if (C == 1) {
-        bool is_const = sp.is_const[0];
-        int lower = sp.lower[0];
-        double sc = scale[0];
-
-        #pragma omp parallel for schedule(runtime)
-        for (ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(N); ++i) {
-            if (!is_const) {
-                int temp = std::lround((img.data[i] - lower) * sc);
-                img.data[i] = static_cast<uint8_t>(temp < 0 ? 0 : (temp > 255 ? 255 : temp));
-            }
-        }
-        return;
-    }
+void stretch_no_omp(Image& img, const StretchParams& sp) {
+    size_t N = static_cast<size_t>(img.width) * img.height;
+    stretch_no_omp(img.data.data(), img.data.data(), N, img.channels, sp);
+}
 
-    // RGB
-    #pragma omp parallel for schedule(runtime)
-    for (ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(N); ++i) {
-        uint8_t* p = &img.data[i * 3];
-        for (int c = 0; c < 3; ++c) {
-            if (!sp.is_const[c]) {
-                int temp = std::lround((p[c] - sp.lower[c]) * scale[c]);
-                p[c] = static_cast<uint8_t>(temp < 0 ? 0 : (temp > 255 ? 255 : temp));
-            }
-        }
-    }
-}
\ No newline at end of file
+void stretch_omp(Image& img, const StretchParams& sp) {
+    size_t N = static_cast<size_t>(img.width) * img.height;
+    stretch_omp(img.data.data(), img.data.data(), N, img.channels, sp);
+}
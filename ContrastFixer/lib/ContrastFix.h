@@ -1,6 +1,13 @@
+#pragma once
+
+#include "Histogram.h"
+
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <new>
 #include <string>
+#include <utility>
 #include <vector>
 
 #ifndef SCHEDULE_KIND
@@ -11,39 +18,115 @@
 #define SCHEDULE_CHUNK_SIZE 0
 #endif
 
+// Аллокатор пиксельных буферов: память выровнена по странице и не заполняется
+// нулями при resize, чтобы страницы первыми касались потоки, которые затем
+// их обрабатывают (first_touch, NUMA).
+template <class T>
+struct PageAllocator {
+    using value_type = T;
+    static constexpr std::size_t kAlign = 4096;
+
+    PageAllocator() = default;
+    template <class U>
+    PageAllocator(const PageAllocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kAlign)));
+    }
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(kAlign));
+    }
+
+    template <class U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <class U, class... A>
+    void construct(U* p, A&&... args) { ::new (static_cast<void*>(p)) U(std::forward<A>(args)...); }
+
+    template <class U>
+    bool operator==(const PageAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const PageAllocator<U>&) const { return false; }
+};
+
+using PixelBuffer = std::vector<std::uint8_t, PageAllocator<std::uint8_t>>;
+
 void print_help(char* argv0);
 
 struct Args {
     std::string in_path;
     std::string out_path;
+    std::string batch_dir;
+    std::string out_dir;
     bool is_omp = false;
     bool threads_default = false;
     int threads = 1;
     double coef = 0.0;
+    bool per_channel = false;
     std::string schedule_kind;
     int chunk_size = 0;
+    bool use_mmap = false;
+    size_t tile_mb = 0;  // 0 — изображение целиком в памяти
+    std::string async_io;  // пусто — обычный ввод-вывод; auto / uring / threads
+    bool wall_time = false;  // печатать полное время с вводом-выводом и без --async-io
+    bool frames = false;
+    double smooth = 0.0;
+    double sample = 1.0;  // доля пикселей для гистограммы; 1 — точный расчёт
+    bool refine = false;
+    bool autotune = false;
+    std::string tune_cache = "contrastfixer.tune";
+    std::string profile;  // JSON-отчёт счётчиков по фазам ("-" — stdout); пусто — выключено
+
+    bool bench = false;
+    std::string bench_sizes = "1024x768x1,1024x768x3,8192x8192x1";
+    std::string bench_threads = "1,2,4,8,16";
+    std::string bench_chunks = "0,1,64,256,1024,2048";
+    int bench_warmup = 2;
+    int bench_reps = 10;
+    std::string bench_out;
 };
 
 bool parse_args(int argc, char** argv, Args& a);
 
+// Каналов на пиксель: 1 (Gray), 2 (Gray + альфа), 3 (RGB), 4 (RGB + альфа).
+constexpr int kMaxChannels = 4;
+
+// Формат файла, из которого прочитано изображение; запись идёт в том же формате.
+enum class PnmFormat { Binary, Ascii, Pam };
+
 struct Image {
     int width = 0;
     int height = 0;
     int channels = 0;
-    std::vector<std::uint8_t> data;
+    int maxval = 255;   // > 255 — 16-битные выборки, big-endian
+    bool alpha = false; // последний канал — альфа (PAM): в порогах не участвует и не растягивается
+    PnmFormat format = PnmFormat::Binary;
+    PixelBuffer data;
 };
 
-bool read_pnm(std::string& path, Image& img);
-bool write_pnm(std::string& path, Image& img);
-
 struct StretchParams {
-    std::array<int, 3>  lower   { 0,   0,   0 };
-    std::array<int, 3>  higher  { 255, 255, 255 };
-    std::array<bool, 3> is_const{ false, false, false };
+    std::array<int, kMaxChannels>  lower   { 0,   0,   0,   0 };
+    std::array<int, kMaxChannels>  higher  { 255, 255, 255, 255 };
+    std::array<bool, kMaxChannels> is_const{ false, false, false, false };
+    int maxval = 255;
 };
 
-StretchParams calc_params_no_omp(Image& img, double coef);
-StretchParams calc_params_omp(Image& img, double coef);
+// per_channel: для RGB пороги считаются по каждому каналу, а не по общей гистограмме.
+// alpha: последний из C каналов — альфа, для него is_const = true.
+StretchParams params_from_hist(const ChannelHist& hist, int C, double coef, int maxval, bool per_channel = false,
+                               bool alpha = false);
+
+StretchParams calc_params_no_omp(const Image& img, double coef, bool per_channel = false);
+StretchParams calc_params_omp(const Image& img, double coef, bool per_channel = false);
+
+void stretch_no_omp(Image& img, const StretchParams& sp);
+void stretch_omp(Image& img, const StretchParams& sp);
+
+// Те же ядра над сырыми буферами (N пикселей по C каналов); src и dst могут совпадать.
+// Разрядность выборок для stretch берётся из sp.maxval.
+StretchParams calc_params_no_omp(const std::uint8_t* data, size_t N, int C, int maxval, double coef,
+                                 bool per_channel = false, bool alpha = false);
+StretchParams calc_params_omp(const std::uint8_t* data, size_t N, int C, int maxval, double coef,
+                              bool per_channel = false, bool alpha = false);
 
-void stretch_no_omp(Image& img, StretchParams& sp);
-void stretch_omp(Image& img, StretchParams& sp);
\ No newline at end of file
+void stretch_no_omp(const std::uint8_t* src, std::uint8_t* dst, size_t N, int C, const StretchParams& sp);
+void stretch_omp(const std::uint8_t* src, std::uint8_t* dst, size_t N, int C, const StretchParams& sp);
\ No newline at end of file
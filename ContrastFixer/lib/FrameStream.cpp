@@ -0,0 +1,120 @@
+#include "FrameStream.h"
+#include "Pnm.h"
+#include <omp.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+
+FrameStretcher::FrameStretcher(double coef, bool per_channel, double smoothing, bool is_omp)
+    : coef_(coef), per_channel_(per_channel), smoothing_(smoothing), is_omp_(is_omp) {}
+
+void FrameStretcher::process(Image& frame) {
+    StretchParams sp = is_omp_ ? calc_params_omp(frame, coef_, per_channel_)
+                               : calc_params_no_omp(frame, coef_, per_channel_);
+
+    if (smoothing_ > 0.0) {
+        const int colors = frame.alpha ? frame.channels - 1 : frame.channels;
+        for (int c = 0; c < colors; ++c) {
+            if (has_prev_) {
+                lower_[c] = smoothing_ * sp.lower[c] + (1.0 - smoothing_) * lower_[c];
+                higher_[c] = smoothing_ * sp.higher[c] + (1.0 - smoothing_) * higher_[c];
+            } else {
+                lower_[c] = sp.lower[c];
+                higher_[c] = sp.higher[c];
+            }
+            sp.lower[c] = static_cast<int>(std::lround(lower_[c]));
+            sp.higher[c] = static_cast<int>(std::lround(higher_[c]));
+            sp.is_const[c] = sp.lower[c] >= sp.higher[c];
+        }
+        has_prev_ = true;
+    }
+
+    if (is_omp_) {
+        stretch_omp(frame, sp);
+    } else {
+        stretch_no_omp(frame, sp);
+    }
+    params_ = sp;
+}
+
+namespace {
+
+constexpr int kFrames = 3;  // чтение / обработка / запись
+
+}  // namespace
+
+bool process_frames(Args& a) {
+    PnmReader reader;
+    if (a.in_path == "-") {
+        reader.attach(std::cin);
+    } else if (!reader.open(a.in_path)) {
+        return false;
+    }
+
+    std::ofstream out_file;
+    std::ostream* out = &std::cout;
+    if (a.out_path != "-") {
+        out_file.open(a.out_path, std::ios::binary);
+        if (!out_file) {
+            std::fprintf(stderr, "Cannot open output file: %s\n", a.out_path.c_str());
+            return false;
+        }
+        out = &out_file;
+    }
+    std::FILE* report = (a.out_path == "-") ? stderr : stdout;
+
+    FrameStretcher stretcher(a.coef, a.per_channel, a.smooth, a.is_omp);
+    Image frames[kFrames];
+
+    auto read_frame = [&](int slot) { return reader.next(frames[slot]); };
+    auto write_frame = [&](int slot) { return write_pnm(*out, frames[slot]); };
+
+    double t0 = omp_get_wtime();
+    size_t count = 0;
+    size_t bytes = 0;
+
+    bool ok = true;
+    bool have = reader.has_next();
+    if (have) ok = read_frame(0);
+
+    std::future<bool> next;
+    std::future<bool> written;
+    for (int slot = 0; ok && have; slot = (slot + 1) % kFrames) {
+        Image& cur = frames[slot];
+        if (count > 0 && (cur.width != frames[(slot + kFrames - 1) % kFrames].width ||
+                          cur.height != frames[(slot + kFrames - 1) % kFrames].height)) {
+            // Сглаживание имеет смысл только между кадрами одного размера.
+            stretcher.reset();
+        }
+
+        // Слот для следующего кадра освобождается после записи кадра count-2,
+        // а запись идёт строго по порядку: достаточно дождаться предыдущей.
+        int next_slot = (slot + 1) % kFrames;
+        have = reader.has_next();
+        if (have) next = std::async(std::launch::async, read_frame, next_slot);
+
+        stretcher.process(cur);
+        ++count;
+        bytes += cur.data.size();
+
+        if (written.valid() && !written.get()) ok = false;
+        written = std::async(std::launch::async, write_frame, slot);
+
+        if (have && !next.get()) ok = false;
+    }
+    if (written.valid() && !written.get()) ok = false;
+    out->flush();
+
+    if (!ok) {
+        std::fprintf(stderr, "Frame stream failed after %zu frames.\n", count);
+        return false;
+    }
+
+    double s = omp_get_wtime() - t0;
+    std::fprintf(report, "Frames: %zu, %.2f s, %.2f fps, %.1f MB/s\n", count, s,
+                 s > 0 ? count / s : 0.0, s > 0 ? bytes / double(1 << 20) / s : 0.0);
+    return true;
+}
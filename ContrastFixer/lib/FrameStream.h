@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <array>
+
+// Растяжение последовательности кадров одного размера.
+// Пороги каждого кадра можно сглаживать экспоненциально с порогами предыдущих
+// (smoothing = alpha в (0, 1]: new = alpha * текущий + (1 - alpha) * прошлый),
+// чтобы яркость видео не «прыгала» от кадра к кадру. 0 — без сглаживания.
+class FrameStretcher {
+public:
+    FrameStretcher(double coef, bool per_channel, double smoothing, bool is_omp);
+
+    // Считает пороги кадра, сглаживает их и растягивает кадр на месте.
+    void process(Image& frame);
+
+    const StretchParams& params() const { return params_; }
+
+    void reset() { has_prev_ = false; }
+
+private:
+    double coef_;
+    bool per_channel_;
+    double smoothing_;
+    bool is_omp_;
+
+    bool has_prev_ = false;
+    std::array<double, kMaxChannels> lower_{};
+    std::array<double, kMaxChannels> higher_{};
+    StretchParams params_;
+};
+
+// Обрабатывает поток кадров PNM, идущих подряд в a.in_path ("-" — stdin),
+// и пишет результат в a.out_path ("-" — stdout). Чтение следующего кадра и
+// запись предыдущего идут одновременно с обработкой текущего; буферы кадров
+// переиспользуются. Печатает число кадров и кадров в секунду.
+bool process_frames(Args& a);
@@ -0,0 +1,207 @@
+#include "Histogram.h"
+#include "Kernels.h"
+#include "Partition.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace {
+
+// Несколько копий счётчиков на канал: соседние пиксели с одинаковым значением
+// попадают в разные копии и не ждут друг друга на цепочке store -> load.
+constexpr int kBanks = 4;
+
+// 32-битные счётчики сбрасываются в 64-битные не реже, чем раз в столько пикселей.
+constexpr size_t kFlushPixels = size_t(1) << 30;
+
+template <int C>
+struct alignas(64) BankedHist {
+    std::uint32_t bank[C][kBanks][256];
+
+    BankedHist() { clear(); }
+
+    void clear() { std::memset(bank, 0, sizeof(bank)); }
+
+    void count(const std::uint8_t* p, size_t n) {
+        size_t i = 0;
+        for (; i + kBanks <= n; i += kBanks) {
+            const std::uint8_t* q = p + i * C;
+            for (int c = 0; c < C; ++c) {
+                bank[c][0][q[c]]++;
+                bank[c][1][q[C + c]]++;
+                bank[c][2][q[2 * C + c]]++;
+                bank[c][3][q[3 * C + c]]++;
+            }
+        }
+        for (; i < n; ++i) {
+            const std::uint8_t* q = p + i * C;
+            for (int c = 0; c < C; ++c) bank[c][0][q[c]]++;
+        }
+    }
+
+    // Складывает копии и бины [v0, v1) в out.
+    void flush(ChannelHist& out, size_t v0, size_t v1) const {
+        for (int c = 0; c < C; ++c) {
+            std::uint64_t* o = out[c].data();
+            #pragma omp simd
+            for (size_t v = v0; v < v1; ++v) {
+                o[v] += static_cast<std::uint64_t>(bank[c][0][v]) + bank[c][1][v] +
+                        bank[c][2][v] + bank[c][3][v];
+            }
+        }
+    }
+};
+
+// 16-битные выборки (big-endian, как в файле): по 65536 счётчиков на канал.
+// Одна копия на канал — при таком числе бинов подряд идущие совпадения редки,
+// а лишние копии вытеснили бы таблицу из L2.
+template <int C>
+struct WideHist {
+    std::vector<std::uint32_t> bins;  // [c * 65536 + v]
+
+    WideHist() : bins(static_cast<size_t>(C) << 16) {}
+
+    void clear() { std::fill(bins.begin(), bins.end(), 0); }
+
+    void count(const std::uint8_t* p, size_t n) {
+        std::uint32_t* b = bins.data();
+        for (size_t i = 0; i < n; ++i) {
+            const std::uint8_t* q = p + 2 * C * i;
+            for (int c = 0; c < C; ++c) b[(c << 16) + Sample16::load(q + 2 * c)]++;
+        }
+    }
+
+    void flush(ChannelHist& out, size_t v0, size_t v1) const {
+        for (int c = 0; c < C; ++c) {
+            std::uint64_t* o = out[c].data();
+            const std::uint32_t* b = bins.data() + (static_cast<size_t>(c) << 16);
+            #pragma omp simd
+            for (size_t v = v0; v < v1; ++v) o[v] += b[v];
+        }
+    }
+};
+
+template <class S, int C>
+using CounterFor = std::conditional_t<S::bytes == 1, BankedHist<C>, WideHist<C>>;
+
+void reset(ChannelHist& hist, int C, int maxval) {
+    hist.assign(C, std::vector<std::uint64_t>(hist_bins(maxval), 0));
+}
+
+// Счётчики потока и 64-битный запас, куда они сбрасываются при переполнении.
+template <class S, int C>
+struct ThreadHist {
+    static constexpr size_t kPixelBytes = static_cast<size_t>(C) * S::bytes;
+    static constexpr size_t kBins = size_t(1) << (8 * S::bytes);
+
+    CounterFor<S, C> cnt;
+    ChannelHist spill;
+
+    void count_range(const std::uint8_t* data, size_t begin, size_t end) {
+        while (begin < end) {
+            size_t n = std::min(end - begin, kFlushPixels);
+            cnt.count(data + begin * kPixelBytes, n);
+            begin += n;
+            if (begin < end) {
+                if (spill.empty()) spill.assign(C, std::vector<std::uint64_t>(kBins, 0));
+                cnt.flush(spill, 0, kBins);
+                cnt.clear();
+            }
+        }
+    }
+
+    void flush(ChannelHist& out, size_t v0, size_t v1) const {
+        cnt.flush(out, v0, v1);
+        if (spill.empty()) return;
+        for (int c = 0; c < C; ++c) {
+            #pragma omp simd
+            for (size_t v = v0; v < v1; ++v) out[c][v] += spill[c][v];
+        }
+    }
+};
+
+// Изображение из height строк по width пикселей, строки через stride байт
+// (непрерывный буфер — одна строка из N пикселей).
+template <class Policy, class S, int C>
+void add_rows(const std::uint8_t* data, size_t width, size_t height, size_t stride, ChannelHist& hist) {
+    using Local = ThreadHist<S, C>;
+    const size_t px = Local::kPixelBytes;
+
+    // Одна строка делится по пикселям, несколько — по строкам.
+    Partition p = (height == 1) ? Policy::plan(width, px) : Policy::plan(height, width * px, width);
+    std::vector<std::unique_ptr<Local>> local(p.threads);
+
+    run_partition(p, [&](int tid, size_t first, size_t count) {
+        // Счётчики выделяются и обнуляются самим потоком (first touch).
+        if (!local[tid]) local[tid] = std::make_unique<Local>();
+        if (height == 1) {
+            local[tid]->count_range(data, first, first + count);
+            return;
+        }
+        for (size_t y = first; y < first + count; ++y) {
+            local[tid]->count_range(data + y * stride, 0, width);
+        }
+    }, Phase::Histogram);
+
+    const size_t bins = Local::kBins;
+    if (bins <= 256 || p.threads <= 1) {
+        PhaseScope scope(Phase::Merge);
+        for (auto& l : local) {
+            if (l) l->flush(hist, 0, bins);
+        }
+        return;
+    }
+
+    // 65536 бинов на канал: слияние тоже параллельно, по диапазонам бинов.
+    const ptrdiff_t parts = p.threads;
+    #pragma omp parallel for num_threads(p.threads)
+    for (ptrdiff_t k = 0; k < parts; ++k) {
+        PhaseScope scope(Phase::Merge);
+        size_t v0 = bins * k / parts;
+        size_t v1 = bins * (k + 1) / parts;
+        for (auto& l : local) {
+            if (l) l->flush(hist, v0, v1);
+        }
+    }
+}
+
+void prepare(ChannelHist& hist, int C, int maxval) {
+    if (hist.size() != static_cast<size_t>(C) || hist[0].size() != hist_bins(maxval)) reset(hist, C, maxval);
+}
+
+}  // namespace
+
+void histogram_add_no_omp(const std::uint8_t* data, size_t N, int C, int maxval, ChannelHist& hist) {
+    histogram_add_rows_no_omp(data, N, 1, 0, C, maxval, hist);
+}
+
+void histogram_add_omp(const std::uint8_t* data, size_t N, int C, int maxval, ChannelHist& hist) {
+    histogram_add_rows_omp(data, N, 1, 0, C, maxval, hist);
+}
+
+template <class Policy>
+void histogram_add_rows_impl(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                             int C, int maxval, ChannelHist& hist) {
+    prepare(hist, C, maxval);
+    dispatch_format(C, maxval, [&](auto sample, auto channels) {
+        add_rows<Policy, decltype(sample), decltype(channels)::value>(data, width, height, stride, hist);
+    });
+}
+
+template void histogram_add_rows_impl<Sequential>(const std::uint8_t*, size_t, size_t, size_t, int, int,
+                                                  ChannelHist&);
+template void histogram_add_rows_impl<Parallel>(const std::uint8_t*, size_t, size_t, size_t, int, int,
+                                                ChannelHist&);
+
+void histogram_add_rows_no_omp(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                               int C, int maxval, ChannelHist& hist) {
+    histogram_add_rows_impl<Sequential>(data, width, height, stride, C, maxval, hist);
+}
+
+void histogram_add_rows_omp(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                            int C, int maxval, ChannelHist& hist) {
+    histogram_add_rows_impl<Parallel>(data, width, height, stride, C, maxval, hist);
+}
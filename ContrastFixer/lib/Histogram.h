@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Гистограмма по каналам: hist[c][v] — число значений v в канале c.
+// 256 бинов для 8-битных выборок, 65536 — для 16-битных (maxval > 255).
+using ChannelHist = std::vector<std::vector<std::uint64_t>>;
+
+// Байт на выборку: 16-битные выборки хранятся big-endian, как в файле PNM.
+inline int sample_bytes(int maxval) { return maxval > 255 ? 2 : 1; }
+inline size_t hist_bins(int maxval) { return maxval > 255 ? 65536 : 256; }
+
+// Подсчёт N пикселей по C каналов (1..kMaxChannels) с добавлением к уже накопленной
+// гистограмме (для обработки по частям). Параллельный вариант: каждый поток считает
+// свои блоки пикселей (см. Partition) в собственные выровненные по кэш-линии
+// счётчики, затем они сливаются.
+void histogram_add_no_omp(const std::uint8_t* data, size_t N, int C, int maxval, ChannelHist& hist);
+void histogram_add_omp(const std::uint8_t* data, size_t N, int C, int maxval, ChannelHist& hist);
+
+// Изображение из height строк по width пикселей; начала строк — через stride байт.
+void histogram_add_rows_no_omp(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                               int C, int maxval, ChannelHist& hist);
+void histogram_add_rows_omp(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                            int C, int maxval, ChannelHist& hist);
@@ -0,0 +1,56 @@
+#include "ImageView.h"
+#include "Kernels.h"
+
+#include <cstdio>
+
+ConstImageView view_of(const Image& img) {
+    return { img.data.data(), img.width, img.height, img.channels, img.maxval, 0, img.alpha };
+}
+
+ImageView view_of(Image& img) {
+    return { img.data.data(), img.width, img.height, img.channels, img.maxval, 0, img.alpha };
+}
+
+StretchParams calc_params(const ConstImageView& src, double coef, bool is_omp, bool per_channel) {
+    size_t W = static_cast<size_t>(src.width);
+    size_t H = static_cast<size_t>(src.height);
+    if (src.contiguous()) {
+        W *= H;
+        H = 1;
+    }
+
+    if (is_omp) {
+        return calc_params_impl<Parallel>(src.data, W, H, src.row_stride(), src.channels, src.maxval, coef,
+                                          per_channel, src.alpha);
+    }
+    return calc_params_impl<Sequential>(src.data, W, H, src.row_stride(), src.channels, src.maxval, coef,
+                                        per_channel, src.alpha);
+}
+
+bool stretch(const ConstImageView& src, const ImageView& dst, const StretchParams& sp, bool is_omp) {
+    if (src.width != dst.width || src.height != dst.height || src.channels != dst.channels ||
+        src.maxval != dst.maxval || src.alpha != dst.alpha || sp.maxval != src.maxval) {
+        std::fprintf(stderr, "stretch: source and destination formats differ.\n");
+        return false;
+    }
+
+    // Строки с отступами делятся между потоками целиком, сплошной буфер — по пикселям.
+    size_t W = static_cast<size_t>(src.width);
+    size_t H = static_cast<size_t>(src.height);
+    if (src.contiguous() && dst.contiguous()) {
+        W *= H;
+        H = 1;
+    }
+
+    if (is_omp) {
+        stretch_rows_impl<Parallel>(src.data, src.row_stride(), dst.data, dst.row_stride(), W, H, src.channels, sp);
+    } else {
+        stretch_rows_impl<Sequential>(src.data, src.row_stride(), dst.data, dst.row_stride(), W, H, src.channels,
+                                      sp);
+    }
+    return true;
+}
+
+void stretch(const ImageView& img, const StretchParams& sp, bool is_omp) {
+    stretch(static_cast<ConstImageView>(img), img, sp, is_omp);
+}
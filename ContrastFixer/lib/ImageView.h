@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Вид на пиксели в чужой памяти (например, буфер декодера), без копирования.
+// Строки идут через stride байт (stride >= width * channels * байт на выборку),
+// 16-битные выборки — big-endian, как в PNM.
+struct ConstImageView {
+    const std::uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+    int maxval = 255;
+    size_t stride = 0;  // 0 — строки идут подряд
+    bool alpha = false; // последний канал — альфа
+
+    size_t row_bytes() const { return static_cast<size_t>(width) * channels * sample_bytes(maxval); }
+    size_t row_stride() const { return stride ? stride : row_bytes(); }
+    bool contiguous() const { return row_stride() == row_bytes(); }
+    const std::uint8_t* row(int y) const { return data + y * row_stride(); }
+};
+
+struct ImageView {
+    std::uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int channels = 1;
+    int maxval = 255;
+    size_t stride = 0;
+    bool alpha = false;
+
+    size_t row_bytes() const { return static_cast<size_t>(width) * channels * sample_bytes(maxval); }
+    size_t row_stride() const { return stride ? stride : row_bytes(); }
+    bool contiguous() const { return row_stride() == row_bytes(); }
+    std::uint8_t* row(int y) const { return data + y * row_stride(); }
+
+    operator ConstImageView() const { return { data, width, height, channels, maxval, stride, alpha }; }
+};
+
+ConstImageView view_of(const Image& img);
+ImageView view_of(Image& img);
+
+// Пороги по виду; изображение не изменяется.
+StretchParams calc_params(const ConstImageView& src, double coef, bool is_omp, bool per_channel = false);
+
+// Растяжение из src в dst (одинаковые размеры и формат, stride может отличаться).
+// src и dst могут указывать на одну и ту же память — тогда растяжение на месте.
+bool stretch(const ConstImageView& src, const ImageView& dst, const StretchParams& sp, bool is_omp);
+
+// Растяжение на месте.
+void stretch(const ImageView& img, const StretchParams& sp, bool is_omp);
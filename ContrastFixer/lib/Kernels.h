@@ -0,0 +1,112 @@
+#pragma once
+
+#include "ContrastFix.h"
+#include "Histogram.h"
+#include "Partition.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Общий движок ядер: гистограмма и растяжение написаны один раз и
+// параметризуются политикой выполнения, форматом выборки, числом каналов и
+// маской каналов-констант. Все ветвления по формату делаются один раз на
+// изображение (dispatch_*), внутренние циклы не содержат проверок C и is_const.
+// Векторизация (AVX2 / SSE4.1) выбирается внутри apply_lut по CPU.
+
+// Политики выполнения: отличаются только разбиением работы.
+struct Sequential {
+    static Partition plan(size_t N, size_t, size_t = 1) {
+        Partition p;
+        p.pixels = N;
+        p.grain = N ? N : 1;
+        p.blocks = N ? 1 : 0;
+        return p;
+    }
+};
+
+struct Parallel {
+    static Partition plan(size_t N, size_t unit_bytes, size_t unit_pixels = 1) {
+        return plan_partition(N, unit_bytes, unit_pixels);
+    }
+};
+
+// Форматы выборки.
+struct Sample8 {
+    using Value = std::uint8_t;
+    static constexpr int bytes = 1;
+    static unsigned load(const std::uint8_t* p) { return p[0]; }
+    static void store(std::uint8_t* p, Value v) { p[0] = v; }
+};
+
+// 16 бит, big-endian, как в файле PNM.
+struct Sample16 {
+    using Value = std::uint16_t;
+    static constexpr int bytes = 2;
+    static unsigned load(const std::uint8_t* p) { return (static_cast<unsigned>(p[0]) << 8) | p[1]; }
+    static void store(std::uint8_t* p, Value v) {
+        p[0] = static_cast<std::uint8_t>(v >> 8);
+        p[1] = static_cast<std::uint8_t>(v);
+    }
+};
+
+template <int C>
+using Channels = std::integral_constant<int, C>;
+
+template <unsigned M>
+using ConstMask = std::integral_constant<unsigned, M>;
+
+// Бит c — канал c не растягивается (is_const).
+inline unsigned const_mask(const StretchParams& sp, int C) {
+    unsigned m = 0;
+    for (int c = 0; c < C; ++c) {
+        if (sp.is_const[c]) m |= 1u << c;
+    }
+    return m;
+}
+
+inline unsigned full_mask(int C) { return (1u << C) - 1; }
+
+// Вызывает f(Sample8{} | Sample16{}, Channels<C>{}) для C из [1, kMaxChannels].
+template <class F>
+void dispatch_format(int C, int maxval, F&& f) {
+    auto channels = [&](auto sample) {
+        switch (C) {
+            case 1: f(sample, Channels<1>{}); break;
+            case 2: f(sample, Channels<2>{}); break;
+            case 3: f(sample, Channels<3>{}); break;
+            default: f(sample, Channels<4>{}); break;
+        }
+    };
+    if (sample_bytes(maxval) == 1) {
+        channels(Sample8{});
+    } else {
+        channels(Sample16{});
+    }
+}
+
+// Вызывает f(ConstMask<mask>{}) для mask из [0, 2^C).
+template <int C, unsigned M = 0, class F>
+void dispatch_mask(unsigned mask, F&& f) {
+    if constexpr (M + 1 < (1u << C)) {
+        if (mask != M) {
+            dispatch_mask<C, M + 1>(mask, f);
+            return;
+        }
+    }
+    f(ConstMask<M>{});
+}
+
+// Гистограмма height строк по width пикселей (строки через stride байт), с добавлением к hist.
+template <class Policy>
+void histogram_add_rows_impl(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                             int C, int maxval, ChannelHist& hist);
+
+template <class Policy>
+StretchParams calc_params_impl(const std::uint8_t* data, size_t width, size_t height, size_t stride,
+                               int C, int maxval, double coef, bool per_channel, bool alpha);
+
+// Растяжение строк src в dst; src и dst могут совпадать.
+template <class Policy>
+void stretch_rows_impl(const std::uint8_t* src, size_t src_stride, std::uint8_t* dst, size_t dst_stride,
+                       size_t width, size_t height, int C, const StretchParams& sp);
@@ -0,0 +1,128 @@
+#include "MappedPnm.h"
+#include "Pnm.h"
+#include <omp.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool MappedFile::open_read(const std::string& path) {
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        std::fprintf(stderr, "Cannot open: %s\n", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) {
+        std::fprintf(stderr, "Cannot stat or empty file: %s\n", path.c_str());
+        return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+        std::fprintf(stderr, "Cannot mmap: %s\n", path.c_str());
+        return false;
+    }
+    data_ = static_cast<std::uint8_t*>(p);
+
+    // Файл читается дважды (гистограмма и растяжение), поэтому страницы
+    // подгружаются заранее и не выбрасываются после первого прохода.
+    madvise(data_, size_, MADV_WILLNEED);
+    return true;
+}
+
+bool MappedFile::create(const std::string& path, size_t size) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0) {
+        std::fprintf(stderr, "Cannot open output file: %s\n", path.c_str());
+        return false;
+    }
+
+    if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        std::fprintf(stderr, "Cannot resize output file: %s\n", path.c_str());
+        return false;
+    }
+    size_ = size;
+
+    void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        std::fprintf(stderr, "Cannot mmap output file: %s\n", path.c_str());
+        return false;
+    }
+    data_ = static_cast<std::uint8_t*>(p);
+
+    madvise(data_, size_, MADV_SEQUENTIAL);
+    return true;
+}
+
+bool process_mapped_pnm(Args& a, int& used_threads, double& ms) {
+    MappedFile in;
+    if (!in.open_read(a.in_path)) {
+        return false;
+    }
+
+    Image hdr;
+    size_t offset = 0;
+    if (!parse_pnm_header(in.data(), in.size(), hdr, offset)) {
+        return false;
+    }
+    if (hdr.format == PnmFormat::Ascii) {
+        std::fprintf(stderr, "--mmap needs binary PNM (P5, P6, P7).\n");
+        return false;
+    }
+
+    size_t N = static_cast<size_t>(hdr.width) * hdr.height;
+    size_t body = N * hdr.channels * sample_bytes(hdr.maxval);
+    if (in.size() - offset < body) {
+        std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+        return false;
+    }
+
+    std::string header = pnm_header(hdr);
+    MappedFile out;
+    if (!out.create(a.out_path, header.size() + body)) {
+        return false;
+    }
+    std::memcpy(out.data(), header.data(), header.size());
+
+    const std::uint8_t* src = in.data() + offset;
+    std::uint8_t* dst = out.data() + header.size();
+
+    double t0 = omp_get_wtime();
+
+    used_threads = 1;
+    if (a.is_omp) {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                used_threads = omp_get_num_threads();
+            }
+        }
+        StretchParams sp = calc_params_omp(src, N, hdr.channels, hdr.maxval, a.coef, a.per_channel, hdr.alpha);
+        stretch_omp(src, dst, N, hdr.channels, sp);
+    } else {
+        StretchParams sp = calc_params_no_omp(src, N, hdr.channels, hdr.maxval, a.coef, a.per_channel, hdr.alpha);
+        stretch_no_omp(src, dst, N, hdr.channels, sp);
+    }
+
+    double t1 = omp_get_wtime();
+    ms = (t1 - t0) * 1000.0;
+
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Файл, отображённый в память (POSIX mmap). Владеет дескриптором и отображением.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open_read(const std::string& path);
+    bool create(const std::string& path, size_t size);
+
+    std::uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    int fd_ = -1;
+    std::uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Двухпроходная обработка без промежуточных копий: гистограмма по отображению входа,
+// растяжение сразу в заранее выделенный отображённый выходной файл.
+// ms — время вычислений (как в обычном режиме).
+bool process_mapped_pnm(Args& a, int& used_threads, double& ms);
@@ -0,0 +1,56 @@
+#include "Partition.h"
+
+#include <numeric>
+
+namespace {
+
+// Меньше этого объёма изображение обрабатывается одним потоком: создание
+// команды и слияние стоят дороже самой работы (см. small-in в benches.csv).
+constexpr size_t kParallelMinBytes = size_t(1) << 20;
+
+// Минимальный объём работы на поток.
+constexpr size_t kMinBytesPerThread = size_t(256) << 10;
+
+// Блоков на поток при dynamic — запас для выравнивания нагрузки.
+constexpr size_t kBlocksPerThread = 4;
+
+constexpr size_t kPageBytes = 4096;
+
+}  // namespace
+
+Partition plan_partition(size_t N, size_t unit_bytes, size_t unit_pixels) {
+    Partition p;
+    p.pixels = N;
+
+    omp_sched_t kind;
+    int chunk = 0;
+    omp_get_schedule(&kind, &chunk);
+    p.dynamic = (static_cast<int>(kind) & ~static_cast<int>(omp_sched_monotonic)) == omp_sched_dynamic;
+
+    size_t bytes = N * unit_bytes;
+    size_t max_threads = static_cast<size_t>(omp_get_max_threads());
+    if (bytes >= kParallelMinBytes) {
+        p.threads = static_cast<int>(std::max<size_t>(1, std::min(max_threads, bytes / kMinBytesPerThread)));
+    }
+
+    if (chunk > 0) {
+        p.grain = static_cast<size_t>(chunk) / std::max<size_t>(unit_pixels, 1);
+    } else {
+        size_t per = (N + p.threads * kBlocksPerThread - 1) / (p.threads * kBlocksPerThread);
+        // Граница блока — на границе страницы памяти.
+        size_t align = kPageBytes / std::gcd(std::max<size_t>(unit_bytes, 1), kPageBytes);
+        p.grain = (per + align - 1) / align * align;
+    }
+    p.grain = std::max<size_t>(p.grain, 1);
+    p.blocks = (N + p.grain - 1) / p.grain;
+
+    return p;
+}
+
+void first_touch(std::uint8_t* data, size_t N, size_t pixel_bytes) {
+    Partition p = plan_partition(N, pixel_bytes);
+    run_partition(p, [&](int, size_t first, size_t count) {
+        size_t end = (first + count) * pixel_bytes;
+        for (size_t off = first * pixel_bytes; off < end; off += kPageBytes) data[off] = 0;
+    });
+}
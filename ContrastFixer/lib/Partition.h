@@ -0,0 +1,66 @@
+#pragma once
+
+#include "Profile.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Разбиение N единиц (пикселей или строк) по unit_bytes байт на блоки для параллельных ядер.
+// Размер блока выбирается по размеру изображения и числу потоков (либо берётся
+// из --chunk_size: он задан в пикселях и переводится в единицы по unit_pixels
+// пикселей в единице, не меньше одной), границы блоков кратны странице памяти. На маленьких
+// изображениях параллелизм не окупается, и разбиение вырождается в один поток.
+struct Partition {
+    int threads = 1;
+    bool dynamic = false;
+    size_t pixels = 0;
+    size_t grain = 0;   // единиц в блоке
+    size_t blocks = 0;
+
+    size_t begin(size_t b) const { return std::min(pixels, b * grain); }
+};
+
+Partition plan_partition(size_t N, size_t unit_bytes, size_t unit_pixels = 1);
+
+// Вызывает f(tid, first, count) для непрерывных диапазонов единиц.
+// static: поток t получает один непрерывный диапазон блоков — тот же при каждом
+// вызове с тем же разбиением, поэтому страницы, которых поток коснулся первым
+// (first_touch), он же потом и обрабатывает. dynamic: блоки раздаются по одному.
+// phase — фаза, в счёт которой идёт работа каждого потока при --profile.
+template <class F>
+void run_partition(const Partition& p, F&& f, Phase phase = Phase::None) {
+    if (p.pixels == 0) {
+        return;
+    }
+    if (p.threads <= 1) {
+        PhaseScope scope(phase);
+        f(0, size_t(0), p.pixels);
+        return;
+    }
+
+    std::atomic<size_t> next{ 0 };
+
+    #pragma omp parallel num_threads(p.threads)
+    {
+        PhaseScope scope(phase);
+        int tid = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+
+        if (p.dynamic) {
+            for (size_t b = next.fetch_add(1, std::memory_order_relaxed); b < p.blocks;
+                 b = next.fetch_add(1, std::memory_order_relaxed)) {
+                f(tid, p.begin(b), p.begin(b + 1) - p.begin(b));
+            }
+        } else {
+            size_t b0 = p.blocks * tid / nt;
+            size_t b1 = p.blocks * (tid + 1) / nt;
+            if (b1 > b0) f(tid, p.begin(b0), p.begin(b1) - p.begin(b0));
+        }
+    }
+}
+
+// Касается каждой страницы буфера тем потоком, который будет её обрабатывать.
+void first_touch(std::uint8_t* data, size_t N, size_t pixel_bytes);
@@ -0,0 +1,604 @@
+#include "Pnm.h"
+#include "Kernels.h"
+#include "Partition.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define CF_X86 1
+#endif
+
+namespace {
+
+constexpr size_t kBufBytes = size_t(1) << 16;
+
+// Заголовок дочитывается небольшими порциями, чтобы при чтении кадров из
+// канала не ждать данных следующего кадра.
+constexpr size_t kHeaderChunk = 512;
+
+// Запас за концом данных буфера для 16-байтовых загрузок.
+constexpr size_t kPad = 16;
+
+// Длина строки в текстовых P2/P3 (по спецификации — не больше 70 символов).
+constexpr size_t kAsciiLine = 70;
+
+enum class Scan { Ok, NeedMore, Bad };
+
+bool is_space(std::uint8_t c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool is_digit(std::uint8_t c) {
+    return static_cast<unsigned>(c - '0') < 10;
+}
+
+struct Cursor {
+    const std::uint8_t* p;
+    size_t len;
+    size_t pos;
+};
+
+// Пропускает пробельные символы и комментарии (от '#' до конца строки).
+Scan skip_space(Cursor& c) {
+    while (c.pos < c.len) {
+        std::uint8_t ch = c.p[c.pos];
+        if (ch == '#') {
+            const void* nl = std::memchr(c.p + c.pos, '\n', c.len - c.pos);
+            if (!nl) return Scan::NeedMore;
+            c.pos = static_cast<size_t>(static_cast<const std::uint8_t*>(nl) - c.p) + 1;
+        } else if (is_space(ch)) {
+            ++c.pos;
+        } else {
+            return Scan::Ok;
+        }
+    }
+    return Scan::NeedMore;
+}
+
+// Десятичное число, за которым идёт пробельный символ или комментарий.
+Scan read_uint(Cursor& c, unsigned& v, const char*& err) {
+    Scan s = skip_space(c);
+    if (s != Scan::Ok) return s;
+
+    size_t start = c.pos;
+    v = 0;
+    while (c.pos < c.len && is_digit(c.p[c.pos])) {
+        v = v * 10 + (c.p[c.pos] - '0');
+        if (v > static_cast<unsigned>(INT_MAX) / 10) {
+            err = "Number too large in PNM header.";
+            return Scan::Bad;
+        }
+        ++c.pos;
+    }
+    if (c.pos == c.len) return Scan::NeedMore;
+    if (c.pos == start || (!is_space(c.p[c.pos]) && c.p[c.pos] != '#')) {
+        err = "Bad PNM header.";
+        return Scan::Bad;
+    }
+    return Scan::Ok;
+}
+
+// Слово до пробельного символа.
+Scan read_word(Cursor& c, std::string& w) {
+    Scan s = skip_space(c);
+    if (s != Scan::Ok) return s;
+
+    size_t start = c.pos;
+    while (c.pos < c.len && !is_space(c.p[c.pos])) ++c.pos;
+    if (c.pos == c.len) return Scan::NeedMore;
+    w.assign(reinterpret_cast<const char*>(c.p + start), c.pos - start);
+    return Scan::Ok;
+}
+
+// Остаток строки без пробелов по краям (значение TUPLTYPE).
+Scan read_line(Cursor& c, std::string& w) {
+    const void* nl = std::memchr(c.p + c.pos, '\n', c.len - c.pos);
+    if (!nl) return Scan::NeedMore;
+    size_t end = static_cast<size_t>(static_cast<const std::uint8_t*>(nl) - c.p);
+    size_t start = c.pos;
+    while (start < end && is_space(c.p[start])) ++start;
+    size_t stop = end;
+    while (stop > start && is_space(c.p[stop - 1])) --stop;
+    w.assign(reinterpret_cast<const char*>(c.p + start), stop - start);
+    c.pos = end + 1;
+    return Scan::Ok;
+}
+
+Scan scan_pam(Cursor& c, Image& img, size_t& offset, const char*& err) {
+    unsigned w = 0, h = 0, depth = 0, maxv = 0;
+    std::string key, tuple;
+    for (;;) {
+        Scan s = read_word(c, key);
+        if (s != Scan::Ok) return s;
+
+        if (key == "ENDHDR") {
+            // Пиксели начинаются со следующей строки.
+            const void* nl = std::memchr(c.p + c.pos, '\n', c.len - c.pos);
+            if (!nl) return Scan::NeedMore;
+            offset = static_cast<size_t>(static_cast<const std::uint8_t*>(nl) - c.p) + 1;
+            break;
+        }
+
+        if (key == "TUPLTYPE") {
+            s = read_line(c, tuple);
+        } else if (key == "WIDTH") {
+            s = read_uint(c, w, err);
+        } else if (key == "HEIGHT") {
+            s = read_uint(c, h, err);
+        } else if (key == "DEPTH") {
+            s = read_uint(c, depth, err);
+        } else if (key == "MAXVAL") {
+            s = read_uint(c, maxv, err);
+        } else {
+            err = "Unknown field in PAM header.";
+            return Scan::Bad;
+        }
+        if (s != Scan::Ok) return s;
+    }
+
+    if (maxv == 0 || maxv > 65535) {
+        err = "Bad max value.";
+        return Scan::Bad;
+    }
+
+    // Без TUPLTYPE тип определяется по глубине.
+    bool alpha = depth == 2 || depth == 4;
+    unsigned colors = depth >= 3 ? 3 : 1;
+    if (!tuple.empty()) {
+        const std::string suffix = "_ALPHA";
+        alpha = tuple.size() > suffix.size() &&
+                tuple.compare(tuple.size() - suffix.size(), suffix.size(), suffix) == 0;
+        std::string base = alpha ? tuple.substr(0, tuple.size() - suffix.size()) : tuple;
+        if (base == "GRAYSCALE" || base == "BLACKANDWHITE") {
+            colors = 1;
+        } else if (base == "RGB") {
+            colors = 3;
+        } else {
+            err = "Unsupported PAM tuple type.";
+            return Scan::Bad;
+        }
+    }
+    if (depth != colors + (alpha ? 1 : 0)) {
+        err = "PAM depth does not match tuple type.";
+        return Scan::Bad;
+    }
+
+    img.width = static_cast<int>(w);
+    img.height = static_cast<int>(h);
+    img.channels = static_cast<int>(depth);
+    img.maxval = static_cast<int>(maxv);
+    img.alpha = alpha;
+    img.format = PnmFormat::Pam;
+    return Scan::Ok;
+}
+
+// Разбор заголовка; NeedMore — заголовок не уместился в [p, p + len).
+Scan scan_header(const std::uint8_t* p, size_t len, Image& img, size_t& offset, const char*& err) {
+    if (len < 3) return Scan::NeedMore;
+    if (p[0] != 'P' || (!is_space(p[2]) && p[2] != '#')) {
+        err = "Bad PNM header.";
+        return Scan::Bad;
+    }
+
+    Cursor c{ p, len, 2 };
+    switch (p[1]) {
+        case '2': img.channels = 1; img.format = PnmFormat::Ascii; break;
+        case '3': img.channels = 3; img.format = PnmFormat::Ascii; break;
+        case '5': img.channels = 1; img.format = PnmFormat::Binary; break;
+        case '6': img.channels = 3; img.format = PnmFormat::Binary; break;
+        case '7': return scan_pam(c, img, offset, err);
+        default:
+            err = "Unsupported PNM type (supported: P2, P3, P5, P6, P7).";
+            return Scan::Bad;
+    }
+    img.alpha = false;
+
+    unsigned w = 0, h = 0, maxv = 0;
+    Scan s = read_uint(c, w, err);
+    if (s == Scan::Ok) s = read_uint(c, h, err);
+    if (s == Scan::Ok) s = read_uint(c, maxv, err);
+    if (s != Scan::Ok) return s;
+
+    if (maxv == 0 || maxv > 65535) {
+        err = "Bad max value.";
+        return Scan::Bad;
+    }
+    img.width = static_cast<int>(w);
+    img.height = static_cast<int>(h);
+    img.maxval = static_cast<int>(maxv);
+
+    if (img.format == PnmFormat::Ascii) {
+        offset = c.pos;
+        return Scan::Ok;
+    }
+
+    // Ровно один пробельный символ перед пикселями (и CRLF от Windows-инструментов).
+    if (!is_space(p[c.pos])) {
+        err = "Bad PNM header.";
+        return Scan::Bad;
+    }
+    if (p[c.pos] == '\r') {
+        if (c.pos + 1 == len) return Scan::NeedMore;
+        if (p[c.pos + 1] == '\n') ++c.pos;
+    }
+    offset = c.pos + 1;
+    return Scan::Ok;
+}
+
+// Маски цифр и пробельных символов в 16 байтах начиная с p.
+#ifdef CF_X86
+inline void classify(const std::uint8_t* p, unsigned& digits, unsigned& spaces) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i is_dig = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i t = _mm_sub_epi8(v, _mm_set1_epi8('\t'));
+    __m128i is_ctl = _mm_cmpeq_epi8(_mm_min_epu8(t, _mm_set1_epi8(4)), t);
+    __m128i is_sp = _mm_or_si128(is_ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+    digits = static_cast<unsigned>(_mm_movemask_epi8(is_dig));
+    spaces = static_cast<unsigned>(_mm_movemask_epi8(is_sp));
+}
+#else
+inline void classify(const std::uint8_t* p, unsigned& digits, unsigned& spaces) {
+    digits = 0;
+    spaces = 0;
+    for (int i = 0; i < 16; ++i) {
+        digits |= static_cast<unsigned>(is_digit(p[i])) << i;
+        spaces |= static_cast<unsigned>(is_space(p[i])) << i;
+    }
+}
+#endif
+
+// Значение числа из len <= 8 цифр, начинающегося с p (за ним в памяти — ещё
+// не меньше 8 - len байт): цифры сворачиваются попарно внутри 64-битного слова.
+inline unsigned parse_digits(const std::uint8_t* p, unsigned len) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+    x -= 0x3030303030303030ull;
+    x <<= 8 * (8 - len);  // лишние байты уходят, слева — ведущие нули
+    x = (x * 10 + (x >> 8)) & 0x00FF00FF00FF00FFull;
+    x = (x * 100 + (x >> 16)) & 0x0000FFFF0000FFFFull;
+    x = (x * 10000 + (x >> 32)) & 0xFFFFFFFFull;
+    return static_cast<unsigned>(x);
+#else
+    unsigned v = 0;
+    for (unsigned i = 0; i < len; ++i) v = v * 10 + (p[i] - '0');
+    return v;
+#endif
+}
+
+enum class Decode { Done, NeedMore, Bad };
+
+// Текстовые выборки P2/P3. Окно из 16 байт классифицируется одной загрузкой
+// (маски цифр и пробелов), начала и длины чисел берутся из масок через ctz,
+// значения собираются без цикла по цифрам. Число, упёршееся в конец окна,
+// разбирается со следующего окна; упёршееся в конец данных — после подкачки
+// буфера (last — данных больше не будет). Байты после последней выборки не
+// проверяются: за ними может идти следующее изображение.
+template <class S>
+Decode decode_ascii(const std::uint8_t* p, size_t len, bool last, unsigned maxval, std::uint8_t* out,
+                    size_t total, size_t& done, size_t& pos, const char*& err) {
+    while (done < total) {
+        size_t avail = len - pos;
+        if (avail == 0) return Decode::NeedMore;
+
+        const unsigned width = avail >= 16 ? 16 : static_cast<unsigned>(avail);
+        const unsigned valid = (1u << width) - 1;
+        unsigned digits = 0, spaces = 0;
+        classify(p + pos, digits, spaces);
+        digits &= valid;
+        spaces &= valid;
+
+        // [0, limit) — только цифры и пробелы.
+        const unsigned other = valid & ~(digits | spaces);
+        const unsigned limit = other ? static_cast<unsigned>(__builtin_ctz(other)) : width;
+        unsigned starts = digits & ~(digits << 1) & ((1u << limit) - 1);
+
+        size_t end = pos;  // конец последнего разобранного числа
+        bool split = false;
+        while (starts && done < total) {
+            unsigned s = static_cast<unsigned>(__builtin_ctz(starts));
+            unsigned e = s + static_cast<unsigned>(__builtin_ctz(~(digits >> s)));
+
+            if (e == width && !(last && width < 16)) {
+                // Число может продолжаться за окном.
+                if (s == 0 && width == 16) {
+                    // Число длиннее окна (допустимо лишь с ведущими нулями) разбирается по одной цифре.
+                    size_t q = pos;
+                    unsigned v = 0;
+                    for (; q < len && is_digit(p[q]); ++q) {
+                        if (v <= maxval) v = v * 10 + (p[q] - '0');
+                    }
+                    if (q == len && !last) return Decode::NeedMore;
+                    if (v > maxval) {
+                        err = "Sample exceeds maxval.";
+                        return Decode::Bad;
+                    }
+                    if (q < len && !is_space(p[q])) {
+                        err = "Bad character in ASCII pixel data.";
+                        return Decode::Bad;
+                    }
+                    S::store(out + done * S::bytes, static_cast<typename S::Value>(v));
+                    ++done;
+                    pos = q;
+                    split = true;
+                    break;
+                }
+                pos += s;
+                if (width < 16) return Decode::NeedMore;
+                split = true;
+                break;
+            }
+            if (e == limit && limit < width) {
+                err = "Bad character in ASCII pixel data.";
+                return Decode::Bad;
+            }
+
+            unsigned z = s;  // ведущие нули значения не меняют
+            while (z + 1 < e && p[pos + z] == '0') ++z;
+            unsigned v = e - z <= 5 ? parse_digits(p + pos + z, e - z) : ~0u;
+            if (v > maxval) {
+                err = "Sample exceeds maxval.";
+                return Decode::Bad;
+            }
+            S::store(out + done * S::bytes, static_cast<typename S::Value>(v));
+            ++done;
+            starts &= starts - 1;
+            end = pos + e;
+        }
+
+        if (split) continue;
+        if (done == total) {
+            pos = end;
+            break;
+        }
+        if (limit < width) {
+            err = "Bad character in ASCII pixel data.";
+            return Decode::Bad;
+        }
+        pos += width;
+    }
+    return Decode::Done;
+}
+
+bool write_ascii(std::ostream& f, const Image& img) {
+    const size_t row = static_cast<size_t>(img.width) * img.channels;
+    const bool wide = sample_bytes(img.maxval) == 2;
+    const std::uint8_t* data = img.data.data();
+
+    std::string out;
+    out.reserve(kBufBytes + kAsciiLine);
+    for (size_t y = 0; y < static_cast<size_t>(img.height); ++y) {
+        size_t col = 0;
+        for (size_t i = 0; i < row; ++i) {
+            size_t k = y * row + i;
+            unsigned v = wide ? Sample16::load(data + 2 * k) : data[k];
+
+            char tmp[8];
+            size_t n = 0;
+            do {
+                tmp[n++] = static_cast<char>('0' + v % 10);
+                v /= 10;
+            } while (v);
+
+            if (col > 0 && col + n > kAsciiLine) {
+                out.back() = '\n';
+                col = 0;
+            }
+            col += n + 1;
+            while (n) out.push_back(tmp[--n]);
+            out.push_back(' ');
+        }
+        if (row > 0) out.back() = '\n';
+
+        if (out.size() >= kBufBytes) {
+            f.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    f.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(f);
+}
+
+}  // namespace
+
+bool parse_pnm_header(const std::uint8_t* p, size_t len, Image& img, size_t& offset) {
+    const char* err = "Unexpected EOF in header.";
+    if (scan_header(p, len, img, offset, err) != Scan::Ok) {
+        std::fprintf(stderr, "%s\n", err);
+        return false;
+    }
+    return true;
+}
+
+std::string pnm_header(const Image& img) {
+    const std::string w = std::to_string(img.width);
+    const std::string h = std::to_string(img.height);
+    const std::string m = std::to_string(img.maxval);
+
+    if (img.format == PnmFormat::Pam) {
+        const int colors = img.alpha ? img.channels - 1 : img.channels;
+        std::string type = colors == 3 ? "RGB" : "GRAYSCALE";
+        if (img.alpha) type += "_ALPHA";
+        return "P7\nWIDTH " + w + "\nHEIGHT " + h + "\nDEPTH " + std::to_string(img.channels) +
+               "\nMAXVAL " + m + "\nTUPLTYPE " + type + "\nENDHDR\n";
+    }
+
+    std::string magic;
+    if (img.format == PnmFormat::Ascii) {
+        magic = (img.channels == 1) ? "P2\n" : "P3\n";
+    } else {
+        magic = (img.channels == 1) ? "P5\n" : "P6\n";
+    }
+    return magic + w + " " + h + "\n" + m + "\n";
+}
+
+bool read_pnm(const std::string& path, Image& img) {
+    PnmReader r;
+    return r.open(path) && r.next(img);
+}
+
+bool read_pnm(std::istream& f, Image& img) {
+    PnmReader r;
+    r.attach(f);
+    return r.next(img);
+}
+
+bool write_pnm(const std::string& path, const Image& img) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) {
+        std::fprintf(stderr, "Cannot open output file: %s\n", path.c_str());
+        return false;
+    }
+
+    return write_pnm(f, img);
+}
+
+bool write_pnm(std::ostream& f, const Image& img) {
+    f << pnm_header(img);
+    if (img.format == PnmFormat::Ascii) {
+        return write_ascii(f, img);
+    }
+    f.write(reinterpret_cast<const char*>(img.data.data()), img.data.size());
+    return static_cast<bool>(f);
+}
+
+bool PnmReader::open(const std::string& path) {
+    file_.open(path, std::ios::binary);
+    if (!file_) {
+        std::fprintf(stderr, "Cannot open: %s\n", path.c_str());
+        return false;
+    }
+    attach(file_);
+    return true;
+}
+
+void PnmReader::attach(std::istream& in) {
+    in_ = &in;
+    buf_.assign(kBufBytes + kPad, 0);
+    pos_ = 0;
+    len_ = 0;
+    eof_ = false;
+}
+
+// Дочитывает до want байт в буфер, сдвинув непрочитанный хвост в начало.
+bool PnmReader::fill(size_t want) {
+    if (eof_ || !in_) return false;
+
+    if (pos_ > 0) {
+        std::memmove(buf_.data(), buf_.data() + pos_, len_ - pos_);
+        len_ -= pos_;
+        pos_ = 0;
+    }
+    if (buf_.size() - kPad - len_ < want) {
+        buf_.resize(len_ + want + kPad);
+    }
+
+    in_->read(reinterpret_cast<char*>(buf_.data() + len_), static_cast<std::streamsize>(want));
+    size_t got = static_cast<size_t>(in_->gcount());
+    len_ += got;
+    if (got == 0) {
+        eof_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool PnmReader::has_next() {
+    for (;;) {
+        while (pos_ < len_ && is_space(buf_[pos_])) ++pos_;
+        if (pos_ < len_) return true;
+        if (!fill(kHeaderChunk)) return false;
+    }
+}
+
+bool PnmReader::next(Image& img) {
+    if (!in_) {
+        std::fprintf(stderr, "PnmReader: no input.\n");
+        return false;
+    }
+
+    Image hdr;
+    size_t offset = 0;
+    for (;;) {
+        const char* err = nullptr;
+        Scan s = scan_header(buf_.data() + pos_, len_ - pos_, hdr, offset, err);
+        if (s == Scan::Ok) break;
+        if (s == Scan::Bad) {
+            std::fprintf(stderr, "%s\n", err);
+            return false;
+        }
+        if (!fill(kHeaderChunk)) {
+            std::fprintf(stderr, len_ == pos_ ? "Bad PNM header.\n" : "Unexpected EOF in header.\n");
+            return false;
+        }
+    }
+    pos_ += offset;
+
+    img.width = hdr.width;
+    img.height = hdr.height;
+    img.channels = hdr.channels;
+    img.maxval = hdr.maxval;
+    img.alpha = hdr.alpha;
+    img.format = hdr.format;
+
+    // Буфер переиспользуется, если размер кадра не вырос.
+    size_t px = static_cast<size_t>(img.channels) * sample_bytes(img.maxval);
+    size_t size = static_cast<size_t>(img.width) * img.height * px;
+    bool fresh = img.data.capacity() < size;
+    img.data.resize(size);
+    if (fresh) {
+        first_touch(img.data.data(), size / px, px);
+    }
+
+    return img.format == PnmFormat::Ascii ? read_ascii(img) : read_binary(img, size);
+}
+
+bool PnmReader::read_binary(Image& img, size_t size) {
+    size_t have = std::min(len_ - pos_, size);
+    std::memcpy(img.data.data(), buf_.data() + pos_, have);
+    pos_ += have;
+
+    if (have < size) {
+        // Остаток тела — прямо в буфер изображения, без промежуточного копирования.
+        std::streamsize rest = static_cast<std::streamsize>(size - have);
+        in_->read(reinterpret_cast<char*>(img.data.data() + have), rest);
+        if (in_->gcount() != rest) {
+            eof_ = true;
+            std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PnmReader::read_ascii(Image& img) {
+    const size_t total = static_cast<size_t>(img.width) * img.height * img.channels;
+    const unsigned maxval = static_cast<unsigned>(img.maxval);
+    const bool wide = sample_bytes(img.maxval) == 2;
+
+    size_t done = 0;
+    for (;;) {
+        const char* err = nullptr;
+        Decode d = wide ? decode_ascii<Sample16>(buf_.data(), len_, eof_, maxval, img.data.data(), total, done,
+                                                 pos_, err)
+                        : decode_ascii<Sample8>(buf_.data(), len_, eof_, maxval, img.data.data(), total, done,
+                                                pos_, err);
+        if (d == Decode::Done) return true;
+        if (d == Decode::Bad) {
+            std::fprintf(stderr, "%s\n", err);
+            return false;
+        }
+        if (eof_) {
+            std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+            return false;
+        }
+        fill(kBufBytes);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Чтение и запись PNM: P5/P6 (двоичные), P2/P3 (текстовые), PAM (P7: GRAYSCALE,
+// RGB, BLACKANDWHITE, в том числе с _ALPHA). Комментарии '#' в заголовке допускаются.
+// Изображение записывается в том же формате, в каком прочитано (Image::format).
+
+bool read_pnm(const std::string& path, Image& img);
+bool write_pnm(const std::string& path, const Image& img);
+
+// Одно изображение из потока. Читатель буферизует поток и может забрать байты
+// следующего изображения — для нескольких изображений подряд нужен PnmReader.
+bool read_pnm(std::istream& f, Image& img);
+bool write_pnm(std::ostream& f, const Image& img);
+
+// Разбор заголовка из памяти; offset — смещение начала пикселей.
+bool parse_pnm_header(const std::uint8_t* p, size_t len, Image& img, size_t& offset);
+std::string pnm_header(const Image& img);
+
+// Последовательное чтение изображений, идущих в файле или потоке подряд,
+// без повторного открытия; буфер пикселей img.data переиспользуется.
+class PnmReader {
+public:
+    bool open(const std::string& path);
+    void attach(std::istream& in);
+
+    // Есть ли ещё изображение (пробелы между изображениями пропускаются).
+    bool has_next();
+    bool next(Image& img);
+
+private:
+    bool fill(size_t want);
+    bool read_binary(Image& img, size_t size);
+    bool read_ascii(Image& img);
+
+    std::ifstream file_;
+    std::istream* in_ = nullptr;
+    std::vector<std::uint8_t> buf_;
+    size_t pos_ = 0;
+    size_t len_ = 0;
+    bool eof_ = false;
+};
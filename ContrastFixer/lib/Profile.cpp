@@ -0,0 +1,225 @@
+#include "Profile.h"
+#include "StretchLut.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#define CF_HAVE_PERF 1
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+// Счётчики группы в порядке открытия; лидер — такты.
+constexpr int kCounters = 4;
+const char* const kCounterNames[kCounters] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+const char* const kPhaseNames[kPhases] = { "read", "histogram", "merge", "stretch", "write" };
+
+struct PhaseTotals {
+    std::uint64_t calls = 0;
+    std::uint64_t ns = 0;
+    std::uint64_t values[kCounters] = {};
+};
+
+struct ThreadProfile {
+    long tid = 0;
+    int omp_thread = 0;
+    int fds[kCounters] = { -1, -1, -1, -1 };
+    bool has[kCounters] = {};
+    int opened = 0;  // счётчиков в группе (has[i] == true)
+    PhaseTotals phase[kPhases];
+
+    ~ThreadProfile() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+};
+
+std::atomic<bool> g_enabled{ false };
+std::mutex g_mutex;
+std::vector<std::unique_ptr<ThreadProfile>> g_threads;
+thread_local ThreadProfile* t_profile = nullptr;
+
+std::uint64_t now_ns() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef CF_HAVE_PERF
+
+int open_counter(std::uint64_t config, int group) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+void open_counters(ThreadProfile& t) {
+    const std::uint64_t configs[kCounters] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    t.fds[0] = open_counter(configs[0], -1);
+    if (t.fds[0] < 0) return;
+    t.has[0] = true;
+    t.opened = 1;
+    // Событие, которого нет у этого CPU (или в виртуальной машине), пропускается.
+    for (int i = 1; i < kCounters; ++i) {
+        t.fds[i] = open_counter(configs[i], t.fds[0]);
+        if (t.fds[i] >= 0) {
+            t.has[i] = true;
+            ++t.opened;
+        }
+    }
+}
+
+// Значения с поправкой на мультиплексирование (группа снималась с PMU).
+bool read_counters(const ThreadProfile& t, std::uint64_t* out) {
+    std::uint64_t buf[3 + kCounters];
+    ssize_t want = static_cast<ssize_t>((3 + t.opened) * sizeof(std::uint64_t));
+    if (t.fds[0] < 0 || read(t.fds[0], buf, sizeof(buf)) < want) return false;
+    double scale = buf[2] ? static_cast<double>(buf[1]) / static_cast<double>(buf[2]) : 1.0;
+    int k = 0;
+    for (int i = 0; i < kCounters; ++i) {
+        out[i] = t.has[i] ? static_cast<std::uint64_t>(static_cast<double>(buf[3 + k++]) * scale) : 0;
+    }
+    return true;
+}
+
+#else
+
+void open_counters(ThreadProfile&) {}
+bool read_counters(const ThreadProfile&, std::uint64_t*) { return false; }
+
+#endif
+
+ThreadProfile& this_thread() {
+    if (!t_profile) {
+        auto t = std::make_unique<ThreadProfile>();
+#ifdef CF_HAVE_PERF
+        t->tid = static_cast<long>(syscall(SYS_gettid));
+#endif
+        t->omp_thread = omp_get_thread_num();
+        open_counters(*t);
+        t_profile = t.get();
+        std::lock_guard<std::mutex> lk(g_mutex);
+        g_threads.push_back(std::move(t));
+    }
+    return *t_profile;
+}
+
+// Поля объекта фазы без закрывающей скобки.
+void print_totals(std::FILE* f, const PhaseTotals& p, const bool* has) {
+    std::fprintf(f, "{\"calls\": %llu, \"ns\": %llu", static_cast<unsigned long long>(p.calls),
+                 static_cast<unsigned long long>(p.ns));
+    for (int i = 0; i < kCounters; ++i) {
+        if (has[i]) std::fprintf(f, ", \"%s\": %llu", kCounterNames[i], static_cast<unsigned long long>(p.values[i]));
+    }
+    if (has[0] && has[1] && p.values[0]) {
+        std::fprintf(f, ", \"ipc\": %.3f", static_cast<double>(p.values[1]) / static_cast<double>(p.values[0]));
+    }
+}
+
+}  // namespace
+
+void profile_start() { g_enabled.store(true, std::memory_order_relaxed); }
+
+bool profile_enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void PhaseScope::begin(Phase p) {
+    ThreadProfile& t = this_thread();
+    phase_ = p;
+    active_ = true;
+    read_counters(t, values_);
+    ns_ = now_ns();
+}
+
+void PhaseScope::end() {
+    std::uint64_t ns = now_ns();
+    ThreadProfile& t = this_thread();
+    PhaseTotals& p = t.phase[static_cast<int>(phase_)];
+    std::uint64_t v[kCounters];
+    if (read_counters(t, v)) {
+        for (int i = 0; i < kCounters; ++i) p.values[i] += v[i] - values_[i];
+    }
+    p.ns += ns - ns_;
+    ++p.calls;
+}
+
+bool write_profile(const std::string& path) {
+    std::FILE* f = path == "-" ? stdout : std::fopen(path.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "Cannot open profile file: %s\n", path.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lk(g_mutex);
+
+    // Столбец счётчика попадает в сводку, только если он есть у всех потоков.
+    bool has[kCounters];
+    bool perf = !g_threads.empty();
+    for (int i = 0; i < kCounters; ++i) {
+        has[i] = !g_threads.empty();
+        for (auto& t : g_threads) has[i] = has[i] && t->has[i];
+    }
+    perf = perf && has[0];
+
+    // lut_engine — реализация apply_lut (avx2 / sse4.1 / scalar), выбранная на этом CPU.
+    std::fprintf(f, "{\n  \"source\": \"%s\",\n  \"lut_engine\": \"%s\",\n  \"threads\": [", perf ? "perf_event" : "clock",
+                 lut_engine_name());
+    PhaseTotals total[kPhases];
+    std::uint64_t ns_max[kPhases] = {};
+    for (size_t k = 0; k < g_threads.size(); ++k) {
+        const ThreadProfile& t = *g_threads[k];
+        std::fprintf(f, "%s\n    {\"tid\": %ld, \"omp_thread\": %d, \"phases\": {", k ? "," : "", t.tid, t.omp_thread);
+        bool first = true;
+        for (int ph = 0; ph < kPhases; ++ph) {
+            const PhaseTotals& p = t.phase[ph];
+            if (!p.calls) continue;
+            std::fprintf(f, "%s\"%s\": ", first ? "" : ", ", kPhaseNames[ph]);
+            print_totals(f, p, t.has);
+            std::fprintf(f, "}");
+            first = false;
+
+            total[ph].calls += p.calls;
+            total[ph].ns += p.ns;
+            ns_max[ph] = std::max(ns_max[ph], p.ns);
+            for (int i = 0; i < kCounters; ++i) total[ph].values[i] += p.values[i];
+        }
+        std::fprintf(f, "}}");
+    }
+
+    // Сводка по фазам: счётчики и ns — сумма по потокам, ns_max — самый долгий поток.
+    std::fprintf(f, "\n  ],\n  \"phases\": {");
+    bool first = true;
+    for (int ph = 0; ph < kPhases; ++ph) {
+        if (!total[ph].calls) continue;
+        std::fprintf(f, "%s\n    \"%s\": ", first ? "" : ",", kPhaseNames[ph]);
+        print_totals(f, total[ph], has);
+        std::fprintf(f, ", \"ns_max\": %llu}", static_cast<unsigned long long>(ns_max[ph]));
+        first = false;
+    }
+    std::fprintf(f, "\n  }\n}\n");
+
+    bool ok = std::ferror(f) == 0;
+    if (f != stdout) ok = std::fclose(f) == 0 && ok;
+    if (!ok) {
+        std::fprintf(stderr, "Cannot write profile file: %s\n", path.c_str());
+    }
+    return ok;
+}
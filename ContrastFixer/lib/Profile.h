@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Профилирование фаз (--profile): на каждом потоке, впервые вошедшем в фазу,
+// открывается группа счётчиков perf_event_open (такты, инструкции, промахи LLC,
+// ошибки предсказания ветвлений, только user space). Если perf недоступен
+// (perf_event_paranoid, контейнер, не Linux) — считается только время.
+// Замер охватывает участок потока целиком, а не отдельные блоки, поэтому
+// при выключенном профилировании цена — одна проверка флага на поток.
+
+enum class Phase { Read, Histogram, Merge, Stretch, Write, None };
+
+constexpr int kPhases = static_cast<int>(Phase::None);
+
+void profile_start();
+bool profile_enabled();
+
+// Отчёт JSON в файл или в stdout ("-").
+bool write_profile(const std::string& path);
+
+// Замер участка текущего потока от конструктора до деструктора.
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase p) {
+        if (p != Phase::None && profile_enabled()) begin(p);
+    }
+    ~PhaseScope() {
+        if (active_) end();
+    }
+
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    void begin(Phase p);
+    void end();
+
+    bool active_ = false;
+    Phase phase_ = Phase::None;
+    std::uint64_t ns_ = 0;
+    std::uint64_t values_[4] = {};
+};
@@ -0,0 +1,135 @@
+#include "Sampling.h"
+#include "Histogram.h"
+#include "Kernels.h"
+#include "Partition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace {
+
+std::uint64_t mix(std::uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+struct SamplePlan {
+    size_t row_step = 1;    // строк в полосе
+    size_t block_step = 1;  // берётся каждый block_step-й блок строки
+    size_t strata = 0;
+};
+
+// Доля rate делится поровну между строками и блоками: 1/rate ≈ row_step * block_step.
+SamplePlan plan_sample(const ConstImageView& src, double rate) {
+    SamplePlan p;
+    double inv = 1.0 / rate;
+    size_t blocks_per_row = (static_cast<size_t>(src.width) + kSampleBlockPixels - 1) / kSampleBlockPixels;
+
+    p.row_step = std::max<size_t>(1, std::min<size_t>(src.height, std::lround(std::sqrt(inv))));
+    p.block_step = std::max<size_t>(1, std::min<size_t>(blocks_per_row, std::lround(inv / p.row_step)));
+    p.strata = (static_cast<size_t>(src.height) + p.row_step - 1) / p.row_step;
+    return p;
+}
+
+template <class S, int C>
+void count_block(const std::uint8_t* p, size_t n, ChannelHist& h) {
+    for (size_t i = 0; i < n; ++i) {
+        for (int c = 0; c < C; ++c) h[c][S::load(p + (i * C + c) * S::bytes)]++;
+    }
+}
+
+}  // namespace
+
+SampledParams calc_params_sampled(const ConstImageView& src, double coef, double rate, bool is_omp,
+                                  bool per_channel) {
+    const int C = src.channels;
+    const size_t px = static_cast<size_t>(C) * sample_bytes(src.maxval);
+    const size_t W = static_cast<size_t>(src.width);
+
+    SamplePlan plan = plan_sample(src, rate);
+
+    // Полоса — одна строка из ~W / block_step пикселей выборки.
+    const size_t stratum_pixels = std::max<size_t>(1, W / plan.block_step);
+    Partition part = plan_partition(plan.strata, stratum_pixels * px, stratum_pixels);
+    if (!is_omp) part.threads = 1;
+
+    std::vector<ChannelHist> local(part.threads);
+    std::vector<size_t> pixels(part.threads, 0);
+    std::vector<size_t> blocks(part.threads, 0);
+
+    dispatch_format(C, src.maxval, [&](auto sample, auto channels) {
+        using S = decltype(sample);
+        constexpr int Ch = decltype(channels)::value;
+
+        run_partition(part, [&](int tid, size_t first, size_t count) {
+            ChannelHist& h = local[tid];
+            if (h.empty()) h.assign(Ch, std::vector<std::uint64_t>(hist_bins(src.maxval), 0));
+
+            for (size_t s = first; s < first + count; ++s) {
+                size_t y0 = s * plan.row_step;
+                size_t rows = std::min(plan.row_step, static_cast<size_t>(src.height) - y0);
+                std::uint64_t r = mix(s);
+                size_t y = y0 + r % rows;
+                size_t offset = (r >> 32) % plan.block_step;
+
+                const std::uint8_t* row = src.row(static_cast<int>(y));
+                for (size_t b = offset * kSampleBlockPixels; b < W; b += plan.block_step * kSampleBlockPixels) {
+                    size_t n = std::min(kSampleBlockPixels, W - b);
+                    count_block<S, Ch>(row + b * px, n, h);
+                    pixels[tid] += n;
+                    blocks[tid] += 1;
+                }
+            }
+        });
+    });
+
+    ChannelHist hist(C, std::vector<std::uint64_t>(hist_bins(src.maxval), 0));
+    SampledParams res;
+    for (int t = 0; t < part.threads; ++t) {
+        if (local[t].empty()) continue;
+        for (int c = 0; c < C; ++c) {
+            for (size_t v = 0; v < hist[c].size(); ++v) hist[c][v] += local[t][c][v];
+        }
+        res.sampled_pixels += pixels[t];
+        res.sampled_blocks += blocks[t];
+    }
+
+    res.sp = params_from_hist(hist, C, coef, src.maxval, per_channel, src.alpha);
+
+    // DKW: sup|F_n - F| <= eps с вероятностью >= 1 - delta.
+    double n = static_cast<double>(std::max<size_t>(res.sampled_blocks, 1));
+    res.rank_error = std::sqrt(std::log(2.0 / kSampleDelta) / (2.0 * n));
+
+    double wide_coef = std::max(0.0, coef - res.rank_error);
+    double narrow_coef = std::min(0.4999, coef + res.rank_error);
+    StretchParams outer = params_from_hist(hist, C, wide_coef, src.maxval, per_channel, src.alpha);
+    StretchParams inner = params_from_hist(hist, C, narrow_coef, src.maxval, per_channel, src.alpha);
+    for (int c = 0; c < C; ++c) {
+        res.lower_min[c] = outer.lower[c];
+        res.higher_max[c] = outer.higher[c];
+        res.lower_max[c] = std::max(inner.lower[c], res.sp.lower[c]);
+        res.higher_min[c] = std::min(inner.higher[c], res.sp.higher[c]);
+    }
+
+    return res;
+}
+
+void print_sampled(const SampledParams& est, int C, const StretchParams* exact) {
+    std::printf("Sample: %zu pixels in %zu blocks, rank error %.4lf (p >= %.2lf)\n",
+                est.sampled_pixels, est.sampled_blocks, est.rank_error, 1.0 - kSampleDelta);
+    for (int c = 0; c < C; ++c) {
+        std::printf("  channel %i: lower %i [%i, %i], higher %i [%i, %i]", c,
+                    est.sp.lower[c], est.lower_min[c], est.lower_max[c],
+                    est.sp.higher[c], est.higher_min[c], est.higher_max[c]);
+        if (exact) {
+            std::printf(", exact %i / %i (diff %+i / %+i)", exact->lower[c], exact->higher[c],
+                        est.sp.lower[c] - exact->lower[c], est.sp.higher[c] - exact->higher[c]);
+        }
+        std::printf("\n");
+    }
+}
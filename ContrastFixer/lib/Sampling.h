@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ContrastFix.h"
+#include "ImageView.h"
+
+#include <array>
+#include <cstddef>
+
+// Приближённые пороги по стратифицированной выборке пикселей.
+struct SampledParams {
+    StretchParams sp;              // оценка порогов
+
+    // Интервалы, в которые с вероятностью не ниже 1 - kSampleDelta попадают
+    // точные пороги (неравенство Дворецкого — Кифера — Вольфовица).
+    std::array<int, kMaxChannels> lower_min{};
+    std::array<int, kMaxChannels> lower_max{};
+    std::array<int, kMaxChannels> higher_min{};
+    std::array<int, kMaxChannels> higher_max{};
+
+    size_t sampled_pixels = 0;
+    size_t sampled_blocks = 0;
+    double rank_error = 0.0;       // eps: допустимая ошибка ранга (доля пикселей)
+};
+
+constexpr double kSampleDelta = 0.05;
+constexpr size_t kSampleBlockPixels = 64;
+
+// rate — доля пикселей в выборке, (0, 1]. Изображение делится на полосы строк,
+// в каждой полосе берётся одна строка (со смещением, зависящим от номера полосы),
+// а в ней — блоки по kSampleBlockPixels соседних пикселей.
+// Ошибка считается консервативно: блок — одно наблюдение.
+SampledParams calc_params_sampled(const ConstImageView& src, double coef, double rate, bool is_omp,
+                                  bool per_channel = false);
+
+// Печатает оценку и доверительные интервалы для C цветовых каналов;
+// exact — точные пороги (--refine) или nullptr.
+void print_sampled(const SampledParams& est, int C, const StretchParams* exact);
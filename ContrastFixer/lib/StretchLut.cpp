@@ -0,0 +1,166 @@
+#include "StretchLut.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CF_X86 1
+#endif
+
+StretchLut build_lut(const StretchParams& sp, int C) {
+    StretchLut lut;
+    lut.channels = C;
+
+    for (int c = 0; c < C; ++c) {
+        auto& t = lut.table[c];
+        if (sp.is_const[c]) {
+            for (int v = 0; v < 256; ++v) t[v] = static_cast<uint8_t>(v);
+            continue;
+        }
+
+        const int top = sp.maxval;
+        double scale = static_cast<double>(top) / (sp.higher[c] - sp.lower[c]);
+        for (int v = 0; v < 256; ++v) {
+            int temp = std::lround((v - sp.lower[c]) * scale);
+            t[v] = static_cast<uint8_t>(temp < 0 ? 0 : (temp > top ? top : temp));
+        }
+    }
+
+    lut.shared = true;
+    for (int c = 1; c < C; ++c) {
+        if (lut.table[c] != lut.table[0]) lut.shared = false;
+    }
+
+    return lut;
+}
+
+static void apply_scalar(const StretchLut& lut, const uint8_t* src, uint8_t* dst, size_t n) {
+    if (lut.shared) {
+        const uint8_t* t = lut.table[0].data();
+        for (size_t i = 0; i < n; ++i) dst[i] = t[src[i]];
+        return;
+    }
+
+    // Разные таблицы по каналам: n кратно числу каналов.
+    const int C = lut.channels;
+    for (size_t i = 0; i < n; i += C) {
+        for (int c = 0; c < C; ++c) dst[i + c] = lut.table[c][src[i + c]];
+    }
+}
+
+#ifdef CF_X86
+
+// Поиск в 256-байтовой таблице через 16 pshufb по 16 байт: для строки k индекс
+// (v ^ (k << 4)) попадает в [0, 16) только при старшем полубайте v == k, а
+// насыщающее прибавление 0x70 выставляет старший бит (-> ноль) во всех остальных.
+
+__attribute__((target("avx2")))
+static void apply_avx2(const StretchLut& lut, const uint8_t* src, uint8_t* dst, size_t n) {
+    const uint8_t* t = lut.table[0].data();
+
+    __m256i rows[16];
+    for (int k = 0; k < 16; ++k) {
+        __m128i r = _mm_load_si128(reinterpret_cast<const __m128i*>(t + k * 16));
+        rows[k] = _mm256_broadcastsi128_si256(r);
+    }
+    const __m256i bias = _mm256_set1_epi8(0x70);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i res = _mm256_setzero_si256();
+        for (int k = 0; k < 16; ++k) {
+            __m256i idx = _mm256_adds_epu8(_mm256_xor_si256(v, _mm256_set1_epi8(static_cast<char>(k << 4))), bias);
+            res = _mm256_or_si256(res, _mm256_shuffle_epi8(rows[k], idx));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), res);
+    }
+
+    for (; i < n; ++i) dst[i] = t[src[i]];
+}
+
+__attribute__((target("sse4.1")))
+static void apply_sse41(const StretchLut& lut, const uint8_t* src, uint8_t* dst, size_t n) {
+    const uint8_t* t = lut.table[0].data();
+
+    __m128i rows[16];
+    for (int k = 0; k < 16; ++k) {
+        rows[k] = _mm_load_si128(reinterpret_cast<const __m128i*>(t + k * 16));
+    }
+    const __m128i bias = _mm_set1_epi8(0x70);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i res = _mm_setzero_si128();
+        for (int k = 0; k < 16; ++k) {
+            __m128i idx = _mm_adds_epu8(_mm_xor_si128(v, _mm_set1_epi8(static_cast<char>(k << 4))), bias);
+            res = _mm_or_si128(res, _mm_shuffle_epi8(rows[k], idx));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), res);
+    }
+
+    for (; i < n; ++i) dst[i] = t[src[i]];
+}
+
+#endif
+
+using ApplyFn = void (*)(const StretchLut&, const uint8_t*, uint8_t*, size_t);
+
+struct LutEngine {
+    ApplyFn fn;
+    const char* name;
+};
+
+static LutEngine pick_engine() {
+#ifdef CF_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return { apply_avx2, "avx2" };
+    if (__builtin_cpu_supports("sse4.1")) return { apply_sse41, "sse4.1" };
+#endif
+    return { apply_scalar, "scalar" };
+}
+
+static const LutEngine& engine() {
+    static const LutEngine e = pick_engine();
+    return e;
+}
+
+void apply_lut(const StretchLut& lut, const uint8_t* src, uint8_t* dst, size_t N) {
+    size_t n = N * lut.channels;
+    if (!lut.shared) {
+        // Три разные таблицы в чередующихся байтах: SIMD-версия требует трёх полных
+        // проходов с масками и медленнее простого табличного цикла.
+        apply_scalar(lut, src, dst, n);
+        return;
+    }
+    engine().fn(lut, src, dst, n);
+}
+
+StretchLut16 build_lut16(const StretchParams& sp, int C) {
+    StretchLut16 lut;
+    lut.channels = C;
+
+    for (int c = 0; c < C; ++c) {
+        auto& t = lut.table[c];
+        t.resize(65536);
+        if (sp.is_const[c]) {
+            for (int v = 0; v < 65536; ++v) t[v] = static_cast<uint16_t>(v);
+            continue;
+        }
+
+        const int top = sp.maxval;
+        double scale = static_cast<double>(top) / (sp.higher[c] - sp.lower[c]);
+        for (int v = 0; v < 65536; ++v) {
+            long temp = std::lround((v - sp.lower[c]) * scale);
+            t[v] = static_cast<uint16_t>(temp < 0 ? 0 : (temp > top ? top : temp));
+        }
+    }
+
+    return lut;
+}
+
+const char* lut_engine_name() {
+    return engine().name;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Таблица растяжения: значение канала -> новое значение.
+// Строится из StretchParams по той же формуле, что и попиксельный расчёт,
+// поэтому результат побитово совпадает.
+struct StretchLut {
+    alignas(64) std::array<std::array<std::uint8_t, 256>, kMaxChannels> table{};
+    int channels = 1;
+    bool shared = true;  // все каналы используют одну таблицу (table[0])
+};
+
+StretchLut build_lut(const StretchParams& sp, int C);
+
+// Применяет таблицу к N пикселям; src и dst могут совпадать.
+// Реализация (AVX2 / SSE4.1 / скалярная) выбирается один раз при первом вызове.
+void apply_lut(const StretchLut& lut, const std::uint8_t* src, std::uint8_t* dst, size_t N);
+
+const char* lut_engine_name();
+
+// Таблица для 16-битных выборок (maxval > 255): 65536 значений на канал,
+// выборки во входе и выходе — big-endian, как в файле.
+struct StretchLut16 {
+    std::array<std::vector<std::uint16_t>, kMaxChannels> table;
+    int channels = 1;
+};
+
+StretchLut16 build_lut16(const StretchParams& sp, int C);
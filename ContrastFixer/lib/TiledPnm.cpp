@@ -0,0 +1,193 @@
+#include "TiledPnm.h"
+#include "Pnm.h"
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <future>
+#include <memory>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kHeaderProbe = 4096;
+constexpr int kBuffers = 3;  // чтение / вычисление / запись
+
+struct Fd {
+    int fd = -1;
+    ~Fd() { if (fd >= 0) close(fd); }
+};
+
+bool read_full(int fd, std::uint8_t* buf, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t r = pread(fd, buf, n, off);
+        if (r <= 0) return false;
+        buf += r;
+        n -= static_cast<size_t>(r);
+        off += r;
+    }
+    return true;
+}
+
+bool write_full(int fd, const std::uint8_t* buf, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t r = pwrite(fd, buf, n, off);
+        if (r <= 0) return false;
+        buf += r;
+        n -= static_cast<size_t>(r);
+        off += r;
+    }
+    return true;
+}
+
+}  // namespace
+
+bool process_tiled_pnm(Args& a, int& used_threads, double& ms) {
+    Fd in;
+    in.fd = open(a.in_path.c_str(), O_RDONLY);
+    if (in.fd < 0) {
+        std::fprintf(stderr, "Cannot open: %s\n", a.in_path.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(in.fd, &st) != 0) {
+        std::fprintf(stderr, "Cannot stat: %s\n", a.in_path.c_str());
+        return false;
+    }
+    size_t file_size = static_cast<size_t>(st.st_size);
+
+    std::uint8_t probe[kHeaderProbe];
+    size_t probe_len = std::min(file_size, kHeaderProbe);
+    if (!read_full(in.fd, probe, probe_len, 0)) {
+        std::fprintf(stderr, "Cannot read header.\n");
+        return false;
+    }
+
+    Image hdr;
+    size_t offset = 0;
+    if (!parse_pnm_header(probe, probe_len, hdr, offset)) {
+        return false;
+    }
+    if (hdr.format == PnmFormat::Ascii) {
+        std::fprintf(stderr, "--tile-mb needs binary PNM (P5, P6, P7).\n");
+        return false;
+    }
+
+    const int C = hdr.channels;
+    const size_t px = static_cast<size_t>(C) * sample_bytes(hdr.maxval);
+    const size_t N = static_cast<size_t>(hdr.width) * hdr.height;
+    if (file_size - offset < N * px) {
+        std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+        return false;
+    }
+
+    Fd out;
+    out.fd = open(a.out_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out.fd < 0) {
+        std::fprintf(stderr, "Cannot open output file: %s\n", a.out_path.c_str());
+        return false;
+    }
+    std::string header = pnm_header(hdr);
+    if (!write_full(out.fd, reinterpret_cast<const std::uint8_t*>(header.data()), header.size(), 0)) {
+        std::fprintf(stderr, "Cannot write output file: %s\n", a.out_path.c_str());
+        return false;
+    }
+
+    // Бюджет делится между тремя буферами; полоса — целое число пикселей.
+    size_t budget = a.tile_mb << 20;
+    size_t strip = std::max<size_t>(1, budget / kBuffers / px);
+    strip = std::min(strip, std::max<size_t>(N, 1));
+    size_t strips = (N + strip - 1) / strip;
+
+    std::unique_ptr<std::uint8_t[]> buf[kBuffers];
+    for (auto& b : buf) b.reset(new std::uint8_t[strip * px]);
+
+    auto count_of = [&](size_t k) { return std::min(strip, N - k * strip); };
+    auto in_off = [&](size_t k) { return static_cast<off_t>(offset + k * strip * px); };
+    auto out_off = [&](size_t k) { return static_cast<off_t>(header.size() + k * strip * px); };
+    auto read_strip = [&](size_t k) {
+        return read_full(in.fd, buf[k % kBuffers].get(), count_of(k) * px, in_off(k));
+    };
+
+    double t0 = omp_get_wtime();
+
+    used_threads = 1;
+    if (a.is_omp) {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                used_threads = omp_get_num_threads();
+            }
+        }
+    }
+
+    // Проход 1: гистограмма.
+    ChannelHist hist;
+
+    std::future<bool> next;
+    bool ok = strips == 0 || read_strip(0);
+    for (size_t k = 0; ok && k < strips; ++k) {
+        if (k + 1 < strips) next = std::async(std::launch::async, read_strip, k + 1);
+
+        const std::uint8_t* p = buf[k % kBuffers].get();
+        if (a.is_omp) {
+            histogram_add_omp(p, count_of(k), C, hdr.maxval, hist);
+        } else {
+            histogram_add_no_omp(p, count_of(k), C, hdr.maxval, hist);
+        }
+
+        if (k + 1 < strips) ok = next.get();
+    }
+    if (!ok) {
+        std::fprintf(stderr, "Unexpected EOF in pixel data.\n");
+        return false;
+    }
+
+    StretchParams sp = params_from_hist(hist, C, a.coef, hdr.maxval, a.per_channel, hdr.alpha);
+
+    // Проход 2: чтение k+1, растяжение k и запись k-1 идут одновременно.
+    std::future<bool> writes[kBuffers];
+    auto write_strip = [&](size_t k) {
+        return write_full(out.fd, buf[k % kBuffers].get(), count_of(k) * px, out_off(k));
+    };
+
+    ok = strips == 0 || read_strip(0);
+    for (size_t k = 0; ok && k < strips; ++k) {
+        if (k + 1 < strips) {
+            // Буфер для полосы k+1 освобождается после записи полосы k-2.
+            auto& w = writes[(k + 1) % kBuffers];
+            if (w.valid() && !w.get()) {
+                ok = false;
+                break;
+            }
+            next = std::async(std::launch::async, read_strip, k + 1);
+        }
+
+        std::uint8_t* p = buf[k % kBuffers].get();
+        if (a.is_omp) {
+            stretch_omp(p, p, count_of(k), C, sp);
+        } else {
+            stretch_no_omp(p, p, count_of(k), C, sp);
+        }
+        writes[k % kBuffers] = std::async(std::launch::async, write_strip, k);
+
+        if (k + 1 < strips) ok = next.get();
+    }
+    for (auto& w : writes) {
+        if (w.valid() && !w.get()) ok = false;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "Tiled I/O failed.\n");
+        return false;
+    }
+
+    double t1 = omp_get_wtime();
+    ms = (t1 - t0) * 1000.0;
+
+    return true;
+}
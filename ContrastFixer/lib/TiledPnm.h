@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ContrastFix.h"
+
+// Обработка PNM полосами в пределах бюджета a.tile_mb мегабайт:
+// первый проход строит гистограмму, второй перечитывает полосы, растягивает
+// и записывает их. Пока считается одна полоса, следующая уже читается,
+// а предыдущая записывается. Пиковое потребление памяти не зависит от размера файла.
+// ms — полное время обработки (чтение и запись совмещены с вычислениями).
+bool process_tiled_pnm(Args& a, int& used_threads, double& ms);
@@ -0,0 +1,428 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    size_t minTasks = 1000;
+    size_t maxTasks = 1000000;
+    int reps = 3;
+    size_t threads = 0;
+    std::string out = "-";
+    std::string shape;
+    bool order = false;
+    bool maxGiven = false;
+    double workUs = 20;
+};
+
+struct Graph {
+    std::vector<TaskId> ids;
+    size_t edges = 0;
+};
+
+struct Row {
+    double addNs = 0;
+    double execNs = 0;
+    double reexecNs = 0;
+    double parallelNs = 0;
+    double getNs = 0;
+    long peakKb = -1;
+};
+
+double nsSince(Clock::time_point t) {
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+}
+
+Future<int> fut(TTaskScheduler& s, const Graph& g, size_t v) { return s.getFutureResult<int>(g.ids[v]); }
+
+void chain(TTaskScheduler& s, Graph& g, size_t n) {
+    g.ids.push_back(s.add([] { return 0; }));
+    for (size_t v = 1; v < n; ++v) {
+        g.ids.push_back(s.add([](int x) { return x + 1; }, fut(s, g, v - 1)));
+        ++g.edges;
+    }
+}
+
+void fan(TTaskScheduler& s, Graph& g, size_t n) {
+    g.ids.push_back(s.add([] { return 0; }));
+    for (size_t v = 1; v < n; ++v) {
+        g.ids.push_back(s.add([](int x) { return x + 1; }, fut(s, g, 0)));
+        ++g.edges;
+    }
+}
+
+void diamonds(TTaskScheduler& s, Graph& g, size_t n) {
+    g.ids.push_back(s.add([] { return 0; }));
+    while (g.ids.size() + 3 <= n) {
+        size_t top = g.ids.size() - 1;
+        g.ids.push_back(s.add([](int x) { return x + 1; }, fut(s, g, top)));
+        g.ids.push_back(s.add([](int x) { return x + 2; }, fut(s, g, top)));
+        size_t l = g.ids.size() - 2;
+        g.ids.push_back(s.add([](int x, int y) { return x + y; }, fut(s, g, l), fut(s, g, l + 1)));
+        g.edges += 4;
+    }
+}
+
+void layered(TTaskScheduler& s, Graph& g, size_t n) {
+    const size_t width = 64;
+    std::mt19937 rng(12345);
+    for (size_t v = 0; v < n; ++v) {
+        if (v < width) {
+            g.ids.push_back(s.add([] { return 1; }));
+            continue;
+        }
+        size_t base = (v / width - 1) * width;
+        auto dep = [&] { return fut(s, g, base + rng() % width); };
+        switch (rng() % 3) {
+            case 0:
+                g.ids.push_back(s.add([](int x) { return x; }, dep()));
+                g.edges += 1;
+                break;
+            case 1:
+                g.ids.push_back(s.add([](int x, int y) { return x + y; }, dep(), dep()));
+                g.edges += 2;
+                break;
+            default:
+                g.ids.push_back(s.add([](int x, int y, int z) { return x + y + z; }, dep(), dep(), dep()));
+                g.edges += 3;
+                break;
+        }
+    }
+}
+
+void reduction(TTaskScheduler& s, Graph& g, size_t n) {
+    size_t leaves = (n + 1) / 2;
+    for (size_t v = 0; v < leaves; ++v) { g.ids.push_back(s.add([] { return 1; })); }
+    for (size_t v = 0; v + 1 < g.ids.size() && g.ids.size() < n; v += 2) {
+        g.ids.push_back(s.add([](int x, int y) { return x + y; }, fut(s, g, v), fut(s, g, v + 1)));
+        g.edges += 2;
+    }
+}
+
+struct Shape {
+    const char* name;
+    void (*build)(TTaskScheduler&, Graph&, size_t);
+};
+
+const Shape kShapes[] = {
+    {"chain", chain},
+    {"fan", fan},
+    {"diamond", diamonds},
+    {"layered", layered},
+    {"reduction", reduction},
+};
+
+TTaskScheduler makeScheduler(bool arena, size_t n) {
+    if (!arena) { return TTaskScheduler(); }
+    TTaskScheduler::Arena a;
+    a.reserveTasks = n;
+    return TTaskScheduler(a);
+}
+
+Row measure(const Shape& shape, size_t n, bool arena, const Options& opt, size_t& tasks, size_t& edges) {
+    Row best;
+    for (int rep = 0; rep < opt.reps; ++rep) {
+        Row r;
+        {
+            TTaskScheduler s = makeScheduler(arena, n);
+            Graph g;
+            g.ids.reserve(n);
+
+            auto t = Clock::now();
+            shape.build(s, g, n);
+            r.addNs = nsSince(t);
+            tasks = g.ids.size();
+            edges = g.edges;
+
+            t = Clock::now();
+            if (!s.executeTopologicallyDetailed().ok) {
+                std::fprintf(stderr, "%s/%zu: execution failed\n", shape.name, n);
+                std::exit(1);
+            }
+            r.execNs = nsSince(t);
+
+            t = Clock::now();
+            s.executeTopologicallyDetailed();
+            r.reexecNs = nsSince(t);
+
+            std::vector<Future<int>> fs;
+            fs.reserve(tasks);
+            for (const TaskId& id : g.ids) { fs.push_back(s.getFutureResult<int>(id)); }
+            long sum = 0;
+            t = Clock::now();
+            for (const Future<int>& f : fs) { sum += f.get(); }
+            r.getNs = nsSince(t);
+            if (sum == -1) { std::fprintf(stderr, "unreachable\n"); }
+        }
+        {
+            TTaskScheduler s = makeScheduler(arena, n);
+            Graph g;
+            g.ids.reserve(n);
+            shape.build(s, g, n);
+            auto t = Clock::now();
+            s.executeParallel(opt.threads);
+            r.parallelNs = nsSince(t);
+        }
+
+        if (rep == 0) {
+            best = r;
+            continue;
+        }
+        best.addNs = std::min(best.addNs, r.addNs);
+        best.execNs = std::min(best.execNs, r.execNs);
+        best.reexecNs = std::min(best.reexecNs, r.reexecNs);
+        best.parallelNs = std::min(best.parallelNs, r.parallelNs);
+        best.getNs = std::min(best.getNs, r.getNs);
+    }
+    return best;
+}
+
+struct Result {
+    Row row;
+    size_t tasks = 0;
+    size_t edges = 0;
+};
+
+// Каждый замер — в отдельном процессе: пик RSS (ru_maxrss) не копится между графами.
+Result measureIsolated(const Shape& shape, size_t n, bool arena, const Options& opt) {
+    Result res;
+    int fds[2];
+    pid_t pid = pipe(fds) == 0 ? fork() : -1;
+    if (pid < 0) {
+        res.row = measure(shape, n, arena, opt, res.tasks, res.edges);
+        return res;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        res.row = measure(shape, n, arena, opt, res.tasks, res.edges);
+        bool ok = write(fds[1], &res, sizeof(res)) == static_cast<ssize_t>(sizeof(res));
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    bool ok = read(fds[0], &res, sizeof(res)) == static_cast<ssize_t>(sizeof(res));
+    close(fds[0]);
+    int status = 0;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) != pid || !ok || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::fprintf(stderr, "%s/%zu: benchmark process failed\n", shape.name, n);
+        std::exit(1);
+    }
+    res.row.peakKb = ru.ru_maxrss;
+    return res;
+}
+
+// Случайный слоистый DAG с длительностями задач: 90% задач по 0.5 * work_us, 10% — по 5.5 * work_us.
+// Ширина слоя — от 1 до 4 * threads: параллелизма лишь немногим больше, чем потоков,
+// и от порядка готовых задач зависит, успеет ли критический путь.
+struct TimedDag {
+    std::vector<double> us;
+    std::vector<std::vector<size_t>> deps;
+    size_t edges = 0;
+};
+
+TimedDag timedLayered(size_t n, double workUs, size_t maxWidth) {
+    TimedDag g;
+    std::mt19937 rng(12345);
+    size_t layerBegin = 0, layerEnd = 0;
+    while (g.us.size() < n) {
+        size_t prevBegin = layerBegin, prevEnd = layerEnd;
+        layerBegin = g.us.size();
+        layerEnd = std::min(n, layerBegin + 1 + rng() % maxWidth);
+        for (size_t v = layerBegin; v < layerEnd; ++v) {
+            g.us.push_back(rng() % 10 == 0 ? 5.5 * workUs : 0.5 * workUs);
+            std::vector<size_t> d;
+            size_t arity = prevEnd > prevBegin ? 1 + rng() % 3 : 0;
+            for (size_t k = 0; k < arity; ++k) { d.push_back(prevBegin + rng() % (prevEnd - prevBegin)); }
+            g.edges += d.size();
+            g.deps.push_back(std::move(d));
+        }
+    }
+    return g;
+}
+
+int spin(double us, int x) {
+    auto end = Clock::now() + std::chrono::nanoseconds(static_cast<long long>(us * 1000));
+    while (Clock::now() < end) {}
+    return x + 1;
+}
+
+enum class OrderMode { Fifo, GivenCost, LearnedCost };
+
+TaskId addTimed(TTaskScheduler& s, const TimedDag& g, const std::vector<TaskId>& ids, size_t v, bool given) {
+    const double us = g.us[v];
+    const std::vector<size_t>& d = g.deps[v];
+    auto f = [&](size_t k) { return s.getFutureResult<int>(ids[d[k]]); };
+    TTaskScheduler::Cost cost{given ? us * 1000 : -1.0};
+    switch (d.size()) {
+        case 0:
+            return s.add(cost, [us] { return spin(us, 0); });
+        case 1:
+            return s.add(cost, [us](int x) { return spin(us, x); }, f(0));
+        case 2:
+            return s.add(cost, [us](int x, int y) { return spin(us, x + y); }, f(0), f(1));
+        default:
+            return s.add(cost, [us](int x, int y, int z) { return spin(us, x + y + z); }, f(0), f(1), f(2));
+    }
+}
+
+// Лучшее из reps время executeParallel по графу, где все задачи помечены грязными.
+// Первый прогон не замеряется: строит CSR и, для LearnedCost, набирает оценки стоимости.
+double makespanNs(const TimedDag& g, OrderMode mode, const Options& opt) {
+    TTaskScheduler s;
+    std::vector<TaskId> ids;
+    ids.reserve(g.us.size());
+    for (size_t v = 0; v < g.us.size(); ++v) { ids.push_back(addTimed(s, g, ids, v, mode == OrderMode::GivenCost)); }
+    s.setReadyOrder(mode == OrderMode::Fifo ? ReadyOrder::Fifo : ReadyOrder::CriticalPath);
+    s.executeParallel(opt.threads);
+    double best = 0;
+    for (int rep = 0; rep < opt.reps; ++rep) {
+        for (const TaskId& id : ids) { s.markDirty(id); }
+        auto t = Clock::now();
+        if (!s.executeParallel(opt.threads).ok) {
+            std::fprintf(stderr, "layered/%zu: execution failed\n", ids.size());
+            std::exit(1);
+        }
+        double ns = nsSince(t);
+        best = rep == 0 ? ns : std::min(best, ns);
+    }
+    return best;
+}
+
+// Нижняя граница makespan: max(критический путь, суммарная работа / потоки).
+double lowerBoundNs(const TimedDag& g, size_t threads, double& criticalNs) {
+    std::vector<double> finish(g.us.size());
+    double work = 0;
+    criticalNs = 0;
+    for (size_t v = 0; v < g.us.size(); ++v) {
+        double start = 0;
+        for (size_t u : g.deps[v]) { start = std::max(start, finish[u]); }
+        finish[v] = start + g.us[v] * 1000;
+        work += g.us[v] * 1000;
+        criticalNs = std::max(criticalNs, finish[v]);
+    }
+    return std::max(criticalNs, work / static_cast<double>(threads));
+}
+
+void runOrderBench(const Options& opt, std::FILE* out) {
+    const struct {
+        const char* name;
+        OrderMode mode;
+    } modes[] = {{"fifo", OrderMode::Fifo}, {"cp_given", OrderMode::GivenCost}, {"cp_learned", OrderMode::LearnedCost}};
+
+    std::fprintf(out, "shape,tasks,edges,threads,work_us,order,makespan_ms,critical_ms,bound_ms,vs_bound\n");
+    for (size_t n = opt.minTasks; n <= opt.maxTasks; n *= 10) {
+        TimedDag g = timedLayered(n, opt.workUs, 4 * opt.threads);
+        double criticalNs = 0;
+        double bound = lowerBoundNs(g, opt.threads, criticalNs);
+        for (const auto& m : modes) {
+            double ns = makespanNs(g, m.mode, opt);
+            std::fprintf(out, "layered,%zu,%zu,%zu,%.1f,%s,%.3f,%.3f,%.3f,%.3f\n", n, g.edges, opt.threads, opt.workUs,
+                         m.name, ns / 1e6, criticalNs / 1e6, bound / 1e6, ns / bound);
+            std::fflush(out);
+        }
+    }
+}
+
+void runShapeBench(const Options& opt, std::FILE* out) {
+    std::fprintf(out, "shape,tasks,edges,storage,threads,add_ns,exec_ns,reexec_ns,parallel_ns,get_ns,peak_rss_kb\n");
+    for (const Shape& shape : kShapes) {
+        if (!opt.shape.empty() && opt.shape != shape.name) { continue; }
+        for (size_t n = opt.minTasks; n <= opt.maxTasks; n *= 10) {
+            for (bool arena : {false, true}) {
+                Result m = measureIsolated(shape, n, arena, opt);
+                const Row& r = m.row;
+                double k = static_cast<double>(m.tasks);
+                std::fprintf(out, "%s,%zu,%zu,%s,%zu,%.1f,%.1f,%.1f,%.1f,%.1f,%ld\n", shape.name, m.tasks, m.edges,
+                             arena ? "arena" : "heap", opt.threads, r.addNs / k, r.execNs / k, r.reexecNs / k,
+                             r.parallelNs / k, r.getNs / k, r.peakKb);
+                std::fflush(out);
+            }
+        }
+    }
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char* v = nullptr;
+        if (!std::strcmp(argv[i], "--min-tasks") && (v = next())) {
+            opt.minTasks = std::strtoull(v, nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--max-tasks") && (v = next())) {
+            opt.maxTasks = std::strtoull(v, nullptr, 10);
+            opt.maxGiven = true;
+        } else if (!std::strcmp(argv[i], "--reps") && (v = next())) {
+            opt.reps = std::atoi(v);
+        } else if (!std::strcmp(argv[i], "--threads") && (v = next())) {
+            opt.threads = std::strtoull(v, nullptr, 10);
+        } else if (!std::strcmp(argv[i], "--out") && (v = next())) {
+            opt.out = v;
+        } else if (!std::strcmp(argv[i], "--shape") && (v = next())) {
+            opt.shape = v;
+        } else if (!std::strcmp(argv[i], "--order")) {
+            opt.order = true;
+        } else if (!std::strcmp(argv[i], "--work-us") && (v = next())) {
+            opt.workUs = std::atof(v);
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--shape chain|fan|diamond|layered|reduction] [--min-tasks N] [--max-tasks N]\n"
+                         "          [--reps R] [--threads T] [--out file.csv]\n"
+                         "       %s --order [--work-us U] [--min-tasks N] [--max-tasks N] [--reps R] [--threads T]\n"
+                         "          [--out file.csv]\n",
+                         argv[0], argv[0]);
+            return false;
+        }
+    }
+    if (opt.order && !opt.maxGiven) { opt.maxTasks = std::min<size_t>(opt.maxTasks, 10000); }
+    if (opt.reps < 1 || opt.minTasks < 4 || opt.maxTasks < opt.minTasks || opt.workUs < 0) {
+        std::fprintf(stderr, "invalid options\n");
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+// Колонки *_ns — лучшее из --reps время, делённое на число задач (get — на число Future).
+// exec — первый executeTopologicallyDetailed: построение CSR и выполнение no-op задач,
+// reexec — повторный вызов на готовом графе, то есть только обход графа.
+// peak_rss_kb — пик RSS процесса замера (-1, если fork недоступен).
+// --order: порядок готовых задач на слоистом DAG с задачами по work_us мкс в среднем —
+// fifo, cp_given (критический путь по точным Cost) и cp_learned (по выученным оценкам);
+// vs_bound — makespan, делённый на нижнюю границу.
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) { return 1; }
+    if (opt.threads == 0) { opt.threads = std::max(1u, std::thread::hardware_concurrency()); }
+
+    std::FILE* out = opt.out == "-" ? stdout : std::fopen(opt.out.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "cannot open %s\n", opt.out.c_str());
+        return 1;
+    }
+
+    if (opt.order) {
+        runOrderBench(opt, out);
+    } else {
+        runShapeBench(opt, out);
+    }
+
+    if (out != stdout && std::fclose(out) != 0) {
+        std::fprintf(stderr, "cannot write %s\n", opt.out.c_str());
+        return 1;
+    }
+    return 0;
+}
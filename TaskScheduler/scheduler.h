@@ -1,83 +1,465 @@
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <utility>
-#include <queue>
-#include <unordered_map>
-#include <unordered_set>
+#include <deque>
 #include <stdexcept>
 #include <typeinfo>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+#include <tuple>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define TS_HAVE_COROUTINES 1
+#include <coroutine>
+#endif
 
-struct Any {
-    struct I {
-        virtual ~I() {}
-        virtual I* clone() const = 0;
-    };
+template <class T>
+struct TypeTag {
+    static constexpr char id = 0;
+};
 
-    template <class T>
-    struct Holder : I {
-        T value;
-        explicit Holder(T v) : value(std::move(v)) {}
-        I* clone() const override { return new Holder<T>(value); }
-    };
+template <class T, class = void>
+struct HasEqualOp : std::false_type {};
+
+template <class T>
+struct HasEqualOp<T, std::void_t<decltype(bool(std::declval<const T&>() == std::declval<const T&>()))>>
+    : std::true_type {};
+
+template <class T>
+struct IsEqualityComparable : HasEqualOp<T> {};
+
+template <class T, class A>
+struct IsEqualityComparable<std::vector<T, A>> : IsEqualityComparable<T> {};
+
+template <class A, class B>
+struct IsEqualityComparable<std::pair<A, B>>
+    : std::bool_constant<IsEqualityComparable<A>::value && IsEqualityComparable<B>::value> {};
 
-    std::unique_ptr<I> ptr;
+template <class T, class = void>
+struct HeapBytes {
+    static size_t of(const T&) { return 0; }
+};
+
+template <class T>
+struct HeapBytes<T, std::void_t<typename T::value_type, decltype(std::declval<const T&>().size())>> {
+    static size_t of(const T& v) { return static_cast<size_t>(v.size()) * sizeof(typename T::value_type); }
+};
+
+class Any {
+public:
+    static constexpr size_t kInlineSize = 4 * sizeof(void*);
 
     Any() = default;
 
-    template <class T>
-    Any(T v) : ptr(new Holder<T>(std::move(v))) {}
+    template <class T, class = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Any>>>
+    Any(T&& v) { emplace<std::decay_t<T>>(std::forward<T>(v)); }
 
-    Any(const Any& o) : ptr(o.ptr ? o.ptr->clone() : nullptr) {}
+    Any(const Any& o) { copyFrom(o); }
+    Any(Any&& o) noexcept { moveFrom(o); }
 
     Any& operator=(const Any& o) {
         if (this != &o) {
-            ptr.reset(o.ptr ? o.ptr->clone() : nullptr);
+            Any tmp(o);
+            reset();
+            moveFrom(tmp);
         }
         return *this;
     }
 
-    Any(Any&&) = default;
-    Any& operator=(Any&&) = default;
+    Any& operator=(Any&& o) noexcept {
+        if (this != &o) {
+            reset();
+            moveFrom(o);
+        }
+        return *this;
+    }
+
+    ~Any() { reset(); }
+
+    template <class T, class... Args>
+    T& emplace(Args&&... args) {
+        return construct<T>([&] { return T(std::forward<Args>(args)...); });
+    }
+
+    template <class F>
+    auto& emplaceResult(F&& f) {
+        return construct<std::decay_t<decltype(f())>>(std::forward<F>(f));
+    }
+
+    template <class T>
+    bool holds() const { return vt_ && vt_->type == &TypeTag<T>::id; }
 
     template <class T>
     T& as() {
-        auto* h = dynamic_cast<Holder<T>*>(ptr.get());
-        if (!h) { throw std::bad_cast(); }
-        return h->value;
+        if (!holds<T>()) { throw std::bad_cast(); }
+        return *static_cast<T*>(data());
     }
 
     template <class T>
     const T& as() const {
-        auto const* h = dynamic_cast<const Holder<T>*>(ptr.get());
-        if (!h) { throw std::bad_cast(); }
-        return h->value;
+        if (!holds<T>()) { throw std::bad_cast(); }
+        return *static_cast<const T*>(data());
+    }
+
+    bool has_value() const { return vt_ != nullptr; }
+
+    size_t bytes() const { return vt_ ? vt_->bytes(*this) : 0; }
+
+    bool equals(const Any& o) const {
+        if (!vt_ || !o.vt_) { return vt_ == o.vt_; }
+        return vt_->type == o.vt_->type && vt_->equal && vt_->equal(*this, o);
+    }
+
+    void reset() {
+        if (vt_ && vt_->destroy) { vt_->destroy(*this); }
+        vt_ = nullptr;
+    }
+
+private:
+    struct VTable {
+        const void* type;
+        bool inlined;
+        bool trivial;
+        void (*destroy)(Any&);
+        void (*copy)(Any&, const Any&);
+        void (*move)(Any&, Any&);
+        bool (*equal)(const Any&, const Any&);
+        size_t (*bytes)(const Any&);
+    };
+
+    template <class T>
+    static constexpr bool fitsInline = sizeof(T) <= kInlineSize && alignof(T) <= alignof(std::max_align_t) &&
+                                       std::is_nothrow_move_constructible_v<T>;
+
+    template <class T>
+    struct Ops {
+        static void destroy(Any& a) {
+            if constexpr (fitsInline<T>) {
+                static_cast<T*>(a.data())->~T();
+            } else {
+                delete static_cast<T*>(a.heap_);
+            }
+        }
+
+        static void copy(Any& dst, const Any& src) {
+            if constexpr (std::is_copy_constructible_v<T>) {
+                const T& v = *static_cast<const T*>(src.data());
+                dst.construct<T>([&] { return T(v); });
+            } else {
+                throw std::logic_error("copy of a move-only result");
+            }
+        }
+
+        static void move(Any& dst, Any& src) {
+            T* p = static_cast<T*>(src.data());
+            ::new (static_cast<void*>(dst.buf_)) T(std::move(*p));
+            p->~T();
+        }
+
+        static size_t bytes(const Any& a) { return sizeof(T) + HeapBytes<T>::of(*static_cast<const T*>(a.data())); }
+
+        static bool equal(const Any& a, const Any& b) {
+            if constexpr (IsEqualityComparable<T>::value) {
+                return *static_cast<const T*>(a.data()) == *static_cast<const T*>(b.data());
+            } else {
+                return false;
+            }
+        }
+
+        static constexpr VTable table = {
+            &TypeTag<T>::id,
+            fitsInline<T>,
+            fitsInline<T> && std::is_trivially_copyable_v<T>,
+            std::is_trivially_destructible_v<T> && fitsInline<T> ? nullptr : &destroy,
+            &copy,
+            &move,
+            IsEqualityComparable<T>::value ? &equal : nullptr,
+            &bytes,
+        };
+    };
+
+    template <class T, class F>
+    T& construct(F&& f) {
+        reset();
+        T* p;
+        if constexpr (fitsInline<T>) {
+            p = ::new (static_cast<void*>(buf_)) T(f());
+        } else {
+            p = new T(f());
+            heap_ = p;
+        }
+        vt_ = &Ops<T>::table;
+        return *p;
+    }
+
+    void* data() { return vt_->inlined ? static_cast<void*>(buf_) : heap_; }
+    const void* data() const { return vt_->inlined ? static_cast<const void*>(buf_) : heap_; }
+
+    void copyFrom(const Any& o) {
+        if (!o.vt_) { return; }
+        if (o.vt_->trivial) {
+            std::memcpy(buf_, o.buf_, kInlineSize);
+            vt_ = o.vt_;
+            return;
+        }
+        o.vt_->copy(*this, o);
+    }
+
+    void moveFrom(Any& o) noexcept {
+        if (!o.vt_) { return; }
+        if (o.vt_->trivial) {
+            std::memcpy(buf_, o.buf_, kInlineSize);
+        } else if (o.vt_->inlined) {
+            o.vt_->move(*this, o);
+        } else {
+            heap_ = o.heap_;
+        }
+        vt_ = o.vt_;
+        o.vt_ = nullptr;
+    }
+
+    union {
+        alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+        void* heap_;
+    };
+    const VTable* vt_ = nullptr;
+};
+
+class GraphArena {
+    struct Block {
+        Block* next;
+    };
+
+    struct Finalizer {
+        Finalizer* next;
+        void (*destroy)(void*);
+        void* obj;
+    };
+
+    Block* blocks_ = nullptr;
+    Finalizer* finalizers_ = nullptr;
+    unsigned char* cur_ = nullptr;
+    unsigned char* end_ = nullptr;
+    size_t blockBytes_;
+
+    void grow(size_t need) {
+        size_t bytes = std::max(blockBytes_, need + sizeof(Block));
+        auto* b = static_cast<Block*>(::operator new(bytes));
+        b->next = blocks_;
+        blocks_ = b;
+        cur_ = reinterpret_cast<unsigned char*>(b + 1);
+        end_ = reinterpret_cast<unsigned char*>(b) + bytes;
+    }
+
+public:
+    explicit GraphArena(size_t blockBytes = size_t(256) << 10) : blockBytes_(blockBytes) {}
+
+    GraphArena(const GraphArena&) = delete;
+    GraphArena& operator=(const GraphArena&) = delete;
+
+    ~GraphArena() {
+        for (Finalizer* f = finalizers_; f; f = f->next) { f->destroy(f->obj); }
+        while (blocks_) {
+            Block* next = blocks_->next;
+            ::operator delete(blocks_);
+            blocks_ = next;
+        }
+    }
+
+    void* allocate(size_t size, size_t align) {
+        auto aligned = [&] {
+            return (reinterpret_cast<std::uintptr_t>(cur_) + align - 1) & ~(std::uintptr_t(align) - 1);
+        };
+        std::uintptr_t p = aligned();
+        if (!cur_ || p + size > reinterpret_cast<std::uintptr_t>(end_)) {
+            grow(size + align);
+            p = aligned();
+        }
+        cur_ = reinterpret_cast<unsigned char*>(p + size);
+        return reinterpret_cast<void*>(p);
+    }
+
+    template <class T, class... Args>
+    T* create(Args&&... args) {
+        Finalizer* f = nullptr;
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            f = static_cast<Finalizer*>(allocate(sizeof(Finalizer), alignof(Finalizer)));
+        }
+        T* obj = ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (f) {
+            f->next = finalizers_;
+            f->destroy = [](void* o) { static_cast<T*>(o)->~T(); };
+            f->obj = obj;
+            finalizers_ = f;
+        }
+        return obj;
     }
+};
+
+inline std::uint64_t& currentParallelGraph() {
+    static thread_local std::uint64_t graph = 0;
+    return graph;
+}
+
+struct SuspendHook {
+    virtual void beforeSuspend() = 0;
 
-    bool has_value() const { return static_cast<bool>(ptr); }
+protected:
+    ~SuspendHook() = default;
 };
 
+inline SuspendHook*& currentSuspendHook() {
+    static thread_local SuspendHook* hook = nullptr;
+    return hook;
+}
+
 struct ResultCellAny {
-    mutable bool ready = false;
-    mutable bool running = false;
+    mutable std::atomic<bool> ready{false};
+    mutable std::atomic<bool> running{false};
+    mutable std::atomic<std::thread::id> runner{};
+    std::atomic<bool> suspendable{false};
     Any value;
+    std::uint64_t graph = 0;
+    size_t index = 0;
+    bool promised = false;
 
     struct ITask {
         virtual ~ITask() = default;
         virtual void execute() = 0;
     };
 
+    struct Waiter {
+        Waiter* next = nullptr;
+        virtual void wake() = 0;
+
+    protected:
+        ~Waiter() = default;
+    };
+
+    struct Blocker final : Waiter {
+        std::mutex m;
+        std::condition_variable cv;
+        bool woken = false;
+
+        void wake() override {
+            std::lock_guard<std::mutex> lock(m);
+            woken = true;
+            cv.notify_one();
+        }
+    };
+
     std::weak_ptr<ITask> producer;
+    mutable std::atomic<std::uintptr_t> waiters{0};
 
     void ensureReady() const {
-        if (ready) { return; }
+        if (ready.load(std::memory_order_acquire)) { return; }
         auto p = producer.lock();
-        if (!p) { throw std::logic_error("no producer bound"); }
-        if (running) { throw std::logic_error("cycle detected during ensureReady"); }
-        running = true;
-        p->execute();
-        running = false;
-        if (!ready) { throw std::runtime_error("producer executed but result not marked ready"); }
+        if (!p) {
+            if (!promised) { throw std::logic_error("no producer bound"); }
+            Blocker b;
+            if (!addWaiter(&b)) { return; }
+            std::unique_lock<std::mutex> lock(b.m);
+            b.cv.wait(lock, [&] { return b.woken; });
+            return;
+        }
+        runProducer(*p);
+    }
+
+    void publish() {
+        ready.store(true, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) == 0) { return; }
+        Waiter* w = reinterpret_cast<Waiter*>(lockWaiters());
+        while (w) {
+            Waiter* next = w->next;
+            w->wake();
+            w = next;
+        }
+        waiters.store(0, std::memory_order_release);
+    }
+
+    void unpublish() {
+        ready.store(false, std::memory_order_release);
+        waiters.store(0, std::memory_order_relaxed);
+    }
+
+    bool addWaiter(Waiter* w) const {
+        std::uintptr_t head = lockWaiters();
+        if (ready.load(std::memory_order_seq_cst)) {
+            waiters.store(head, std::memory_order_release);
+            return false;
+        }
+        w->next = reinterpret_cast<Waiter*>(head);
+        waiters.store(reinterpret_cast<std::uintptr_t>(w), std::memory_order_release);
+        return true;
+    }
+
+    void removeWaiter(Waiter* w) const {
+        Waiter* head = reinterpret_cast<Waiter*>(lockWaiters());
+        for (Waiter** p = &head; *p; p = &(*p)->next) {
+            if (*p == w) {
+                *p = w->next;
+                break;
+            }
+        }
+        waiters.store(reinterpret_cast<std::uintptr_t>(head), std::memory_order_release);
+    }
+
+    std::uintptr_t lockWaiters() const {
+        std::uintptr_t w = waiters.load(std::memory_order_relaxed);
+        for (;;) {
+            if (w & 1) {
+                std::this_thread::yield();
+                w = waiters.load(std::memory_order_relaxed);
+            } else if (waiters.compare_exchange_weak(w, w | 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return w;
+            }
+        }
+    }
+
+    void runProducer(ITask& p) const {
+        for (;;) {
+            if (ready.load(std::memory_order_acquire)) { return; }
+            bool expected = false;
+            if (running.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) { break; }
+            if (runner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+                throw std::logic_error("cycle detected during ensureReady");
+            }
+            if (suspendable.load(std::memory_order_acquire) && currentParallelGraph() == graph) {
+                throw std::logic_error("get() of a running coroutine task inside executeParallel; use co_await");
+            }
+            std::this_thread::yield();
+        }
+        if (ready.load(std::memory_order_acquire)) {
+            running.store(false, std::memory_order_release);
+            return;
+        }
+        runner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        try {
+            p.execute();
+        } catch (...) {
+            runner.store(std::thread::id(), std::memory_order_relaxed);
+            running.store(false, std::memory_order_release);
+            throw;
+        }
+        runner.store(std::thread::id(), std::memory_order_relaxed);
+        running.store(false, std::memory_order_release);
+        if (!ready.load(std::memory_order_acquire)) {
+            throw std::runtime_error("producer executed but result not marked ready");
+        }
     }
 };
 
@@ -98,8 +480,138 @@ public:
     bool valid() const { return static_cast<bool>(cell); }
 
     std::shared_ptr<ResultCellAny> cellPtr() const { return cell; }
+    ResultCellAny* rawCell() const { return cell.get(); }
+};
+
+template <class T>
+class Promise {
+    std::shared_ptr<ResultCellAny> cell;
+
+public:
+    Promise() : cell(std::make_shared<ResultCellAny>()) { cell->promised = true; }
+
+    Future<T> getFuture() const { return Future<T>(cell); }
+
+    template <class... Args>
+    void set(Args&&... args) {
+        if (cell->ready.load(std::memory_order_acquire)) { throw std::logic_error("promise already satisfied"); }
+        cell->value.emplace<T>(std::forward<Args>(args)...);
+        cell->publish();
+    }
+};
+
+#ifdef TS_HAVE_COROUTINES
+
+struct CoTaskState : ResultCellAny::Waiter {
+    enum { kIdle, kRunning, kSuspended, kWoken, kQueued };
+
+    std::atomic<int> state{kIdle};
+    bool async = false;
+    bool yielded = false;
+    std::uint64_t graph = 0;
+    size_t index = 0;
+    const ResultCellAny* awaiting = nullptr;
+
+    virtual void requeue() = 0;
+
+    void wake() override {
+        int s = state.load(std::memory_order_acquire);
+        for (;;) {
+            if (s == kSuspended) {
+                if (state.compare_exchange_weak(s, kQueued, std::memory_order_acq_rel)) {
+                    requeue();
+                    return;
+                }
+            } else if (s == kRunning) {
+                if (state.compare_exchange_weak(s, kWoken, std::memory_order_acq_rel)) { return; }
+            } else {
+                return;
+            }
+        }
+    }
+
+protected:
+    ~CoTaskState() = default;
+};
+
+template <class T>
+class CoTask {
+public:
+    using value_type = T;
+
+    struct promise_type {
+        ResultCellAny* out = nullptr;
+        CoTaskState* state = nullptr;
+        std::exception_ptr error;
+
+        CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_value(T v) { out->value.emplace<T>(std::move(v)); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    CoTask(CoTask&& o) noexcept : h(std::exchange(o.h, nullptr)) {}
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask() { if (h) { h.destroy(); } }
+
+    Handle release() { return std::exchange(h, nullptr); }
+
+private:
+    explicit CoTask(Handle hh) : h(hh) {}
+
+    Handle h;
+};
+
+template <class X>
+struct IsCoTask : std::false_type {};
+
+template <class T>
+struct IsCoTask<CoTask<T>> : std::true_type {};
+
+template <class U>
+struct FutureAwaiter {
+    Future<U> f;
+
+    bool await_ready() const { return f.rawCell()->ready.load(std::memory_order_acquire); }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> h) {
+        CoTaskState& t = *h.promise().state;
+        const ResultCellAny* c = f.rawCell();
+        bool async = t.async && (c->promised || (c->graph == t.graph && c->index < t.index));
+        if (!async) {
+            c->ensureReady();
+            return false;
+        }
+        t.awaiting = c;
+        return c->addWaiter(&t);
+    }
+
+    const U& await_resume() const { return f.get(); }
+};
+
+template <class U>
+FutureAwaiter<U> operator co_await(const Future<U>& f) { return FutureAwaiter<U>{f}; }
+
+struct CoYield {
+    bool await_ready() const noexcept { return false; }
+
+    template <class P>
+    bool await_suspend(std::coroutine_handle<P> h) const noexcept {
+        CoTaskState& t = *h.promise().state;
+        t.yielded = t.async;
+        return t.async;
+    }
+
+    void await_resume() const noexcept {}
 };
 
+#endif
+
 template <class X>
 struct ArgWrap {
     X v;
@@ -110,7 +622,7 @@ struct ArgWrap {
 
     const X& get() const { return v; }
 
-    std::shared_ptr<ResultCellAny> depCell() const { return {}; }
+    ResultCellAny* depCell() const { return nullptr; }
 };
 
 template <class U>
@@ -122,7 +634,7 @@ struct ArgWrap<Future<U>> {
 
     const U& get() const { return f.get(); }
 
-    std::shared_ptr<ResultCellAny> depCell() const { return f.cellPtr(); }
+    ResultCellAny* depCell() const { return f.rawCell(); }
 };
 
 struct TaskId {
@@ -134,92 +646,551 @@ struct TaskId {
     bool valid() const { return static_cast<bool>(out); }
 };
 
+struct TaskTrace {
+    size_t task = 0;
+    size_t worker = 0;
+    bool ran = false;
+    std::uint64_t readyNs = 0;
+    std::uint64_t startNs = 0;
+    std::uint64_t endNs = 0;
+    std::uint64_t activeNs = 0;
+    size_t resultBytes = 0;
+
+    std::uint64_t waitNs() const { return startNs - readyNs; }
+    std::uint64_t durationNs() const { return endNs - startNs; }
+};
+
+struct ExecTrace {
+    size_t workers = 0;
+    std::uint64_t wallNs = 0;
+    std::uint64_t busyNs = 0;
+    std::uint64_t criticalNs = 0;
+    std::vector<size_t> criticalPath;
+    std::vector<TaskTrace> tasks;
+
+    double efficiency() const {
+        return wallNs && workers ? static_cast<double>(busyNs) / (static_cast<double>(wallNs) * workers) : 0.0;
+    }
+};
+
+enum class ReadyOrder { Fifo, CriticalPath };
+
 class TTaskScheduler {
     struct ITaskBase {
         virtual ~ITaskBase() {}
         virtual void execute() = 0;
+        virtual bool run(bool& changed) = 0;
         virtual bool ready() const = 0;
-        virtual std::shared_ptr<ResultCellAny> output() const = 0;
-        virtual std::vector<std::shared_ptr<ResultCellAny>> deps() const = 0;
+        virtual bool recompute(bool& changed) = 0;
+        virtual void cancel() {}
+        virtual const ResultCellAny& result() const = 0;
     };
 
-    std::vector<std::shared_ptr<ITaskBase>> tasks_;
-
-    static void bindProducer(const std::shared_ptr<ResultCellAny>& c,
-                             const std::shared_ptr<ResultCellAny::ITask>& p) {
-        c->producer = p;
+    class WorkDeque;
+
+    std::uint64_t graphId_;
+    std::shared_ptr<WorkDeque> wakeups_ = std::make_shared<WorkDeque>();
+    std::shared_ptr<GraphArena> cells_;
+    std::shared_ptr<GraphArena> taskArena_;
+    std::vector<std::shared_ptr<ITaskBase>> owned_;
+    std::vector<ITaskBase*> tasks_;
+    std::vector<size_t> depBegin_{0};
+    std::vector<size_t> depIndex_;
+    std::vector<ResultCellAny*> external_;
+    std::vector<size_t> succBegin_;
+    std::vector<size_t> succIndex_;
+    std::vector<unsigned char> dirty_;
+    bool tracing_ = false;
+    ExecTrace trace_;
+    ReadyOrder readyOrder_ = ReadyOrder::Fifo;
+    std::vector<double> cost_;
+    std::vector<double> learned_;
+    std::vector<double> priority_;
+    std::vector<double> rank_;
+    std::vector<std::uint64_t> sample_;
+    std::chrono::steady_clock::time_point traceStart_;
+
+    static std::uint64_t nextGraphId() {
+        static std::atomic<std::uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
     }
 
-    template <class Callable>
-    struct Task0 : ITaskBase, ResultCellAny::ITask {
+    template <class Callable, class... As>
+    struct TaskN : ITaskBase, ResultCellAny::ITask {
         Callable fn;
+        std::tuple<ArgWrap<As>...> args;
         std::shared_ptr<ResultCellAny> out;
 
-        Task0(Callable f, std::shared_ptr<ResultCellAny> o) : fn(std::move(f)), out(std::move(o)) {}
+        TaskN(Callable f, As... xs, std::shared_ptr<ResultCellAny> o)
+            : fn(std::move(f)), args(ArgWrap<As>(std::move(xs))...), out(std::move(o)) {}
 
         void execute() override {
-            if (out->ready) { return; }
-            out->value = Any(fn());
-            out->ready = true;
+            if (out->ready.load(std::memory_order_acquire)) { return; }
+            out->value.emplaceResult([&] {
+                return std::apply([&](const ArgWrap<As>&... a) { return fn(a.get()...); }, args);
+            });
+            out->publish();
+        }
+
+        bool run(bool& changed) override {
+            out->runProducer(*this);
+            changed = true;
+            return true;
         }
 
-        bool ready() const override { return out->ready; }
-        std::shared_ptr<ResultCellAny> output() const override { return out; }
-        std::vector<std::shared_ptr<ResultCellAny>> deps() const override { return {}; }
+        bool ready() const override { return out->ready.load(std::memory_order_acquire); }
+        const ResultCellAny& result() const override { return *out; }
+
+        bool recompute(bool& changed) override {
+            Any old(std::move(out->value));
+            out->unpublish();
+            out->runProducer(*this);
+            changed = !out->value.equals(old);
+            return true;
+        }
+
+        template <class F>
+        void forEachDep(F&& f) const {
+            std::apply([&](const ArgWrap<As>&... a) { (f(a.depCell()), ...); }, args);
+        }
+    };
+
+    struct RankLess {
+        const double* priority;
+        const double* rank;
+
+        bool operator()(size_t a, size_t b) const {
+            if (priority[a] != priority[b]) { return priority[a] < priority[b]; }
+            if (rank[a] != rank[b]) { return rank[a] < rank[b]; }
+            return a > b;
+        }
+    };
+
+    class IdleGate {
+        std::mutex m_;
+        std::condition_variable cv_;
+        std::atomic<std::uint64_t> epoch_{0};
+        std::atomic<size_t> sleepers_{0};
+
+    public:
+        std::uint64_t epoch() const { return epoch_.load(std::memory_order_seq_cst); }
+
+        void wait(std::uint64_t seen) {
+            std::unique_lock<std::mutex> lock(m_);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            cv_.wait(lock, [&] { return epoch_.load(std::memory_order_seq_cst) != seen; });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void notify(bool all) {
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_seq_cst) == 0) { return; }
+            std::lock_guard<std::mutex> lock(m_);
+            if (all) { cv_.notify_all(); } else { cv_.notify_one(); }
+        }
+    };
+
+    class WorkDeque {
+        std::mutex m_;
+        std::deque<size_t> q_;
+        const RankLess* less_ = nullptr;
+        IdleGate* idle_ = nullptr;
+
+        size_t popTop() {
+            std::pop_heap(q_.begin(), q_.end(), *less_);
+            size_t v = q_.back();
+            q_.pop_back();
+            return v;
+        }
+
+    public:
+        void order(const RankLess* less) { less_ = less; }
+
+        void notify(IdleGate* idle) {
+            std::lock_guard<std::mutex> lock(m_);
+            idle_ = idle;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(m_);
+            q_.clear();
+        }
+
+        void push(size_t v) {
+            IdleGate* idle;
+            {
+                std::lock_guard<std::mutex> lock(m_);
+                q_.push_back(v);
+                if (less_) { std::push_heap(q_.begin(), q_.end(), *less_); }
+                idle = idle_;
+            }
+            if (idle) { idle->notify(false); }
+        }
+
+        bool pop(size_t& v) {
+            std::lock_guard<std::mutex> lock(m_);
+            if (q_.empty()) { return false; }
+            if (less_) {
+                v = popTop();
+                return true;
+            }
+            v = q_.back();
+            q_.pop_back();
+            return true;
+        }
+
+        bool steal(size_t& v) {
+            std::lock_guard<std::mutex> lock(m_);
+            if (q_.empty()) { return false; }
+            if (less_) {
+                v = popTop();
+                return true;
+            }
+            v = q_.front();
+            q_.pop_front();
+            return true;
+        }
     };
 
-    template <class Callable, class A1>
-    struct Task1 : ITaskBase, ResultCellAny::ITask {
+    static bool steal(std::vector<WorkDeque>& queues, size_t self, size_t& v) {
+        for (size_t k = 1; k < queues.size(); ++k) {
+            if (queues[(self + k) % queues.size()].steal(v)) { return true; }
+        }
+        return false;
+    }
+
+#ifdef TS_HAVE_COROUTINES
+    template <class Callable, class... As>
+    struct CoTaskN : ITaskBase, ResultCellAny::ITask, CoTaskState {
+        using Co = std::invoke_result_t<Callable&, decltype(std::declval<const ArgWrap<As>&>().get())...>;
+
+        WorkDeque* wakeups;
         Callable fn;
-        ArgWrap<A1> a1;
+        std::tuple<ArgWrap<As>...> args;
         std::shared_ptr<ResultCellAny> out;
+        typename Co::Handle h;
+        Any prev;
+
+        CoTaskN(WorkDeque* w, Callable f, As... xs, std::shared_ptr<ResultCellAny> o)
+            : wakeups(w), fn(std::move(f)), args(ArgWrap<As>(std::move(xs))...), out(std::move(o)) {}
 
-        Task1(Callable f, A1 x1, std::shared_ptr<ResultCellAny> o)
-            : fn(std::move(f)), a1(std::move(x1)), out(std::move(o)) {}
+        ~CoTaskN() override { cancel(); }
 
         void execute() override {
-            if (out->ready) { return; }
-            out->value = Any(fn(a1.get()));
-            out->ready = true;
+            if (out->ready.load(std::memory_order_acquire)) { return; }
+            start(false);
+            if (!step()) {
+                destroyFrame();
+                throw std::logic_error("coroutine task suspended outside executeParallel");
+            }
+            bool changed = false;
+            finish(changed);
+        }
+
+        bool run(bool& changed) override {
+            int queued = kQueued;
+            if (!state.compare_exchange_strong(queued, kRunning, std::memory_order_acq_rel)) {
+                bool expected = false;
+                if (!out->running.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    out->ensureReady();
+                    changed = true;
+                    return true;
+                }
+                if (out->ready.load(std::memory_order_acquire)) {
+                    out->running.store(false, std::memory_order_release);
+                    changed = true;
+                    return true;
+                }
+                try {
+                    start(currentParallelGraph() == out->graph);
+                } catch (...) {
+                    out->running.store(false, std::memory_order_release);
+                    throw;
+                }
+            }
+            out->runner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            if (!step()) { return false; }
+            out->runner.store(std::thread::id(), std::memory_order_relaxed);
+            try {
+                finish(changed);
+            } catch (...) {
+                out->running.store(false, std::memory_order_release);
+                throw;
+            }
+            out->running.store(false, std::memory_order_release);
+            return true;
         }
 
-        bool ready() const override { return out->ready; }
-        std::shared_ptr<ResultCellAny> output() const override { return out; }
+        bool ready() const override { return out->ready.load(std::memory_order_acquire); }
+        const ResultCellAny& result() const override { return *out; }
+
+        bool recompute(bool& changed) override {
+            prev = std::move(out->value);
+            out->unpublish();
+            return run(changed);
+        }
 
-        std::vector<std::shared_ptr<ResultCellAny>> deps() const override {
-            std::vector<std::shared_ptr<ResultCellAny>> d;
-            if (auto c = a1.depCell()) { d.push_back(std::move(c)); }
-            return d;
+        void cancel() override {
+            if (!h) { return; }
+            if (awaiting) { awaiting->removeWaiter(this); }
+            destroyFrame();
+            out->running.store(false, std::memory_order_release);
+        }
+
+        void requeue() override { wakeups->push(index); }
+
+        template <class F>
+        void forEachDep(F&& f) const {
+            std::apply([&](const ArgWrap<As>&... a) { (f(a.depCell()), ...); }, args);
+        }
+
+        void start(bool asyncMode) {
+            async = asyncMode;
+            graph = out->graph;
+            index = out->index;
+            Co co = std::apply([&](const ArgWrap<As>&... a) { return fn(a.get()...); }, args);
+            h = co.release();
+            h.promise().out = out.get();
+            h.promise().state = this;
+            state.store(kRunning, std::memory_order_relaxed);
+            out->suspendable.store(asyncMode, std::memory_order_release);
+        }
+
+        bool step() {
+            for (;;) {
+                awaiting = nullptr;
+                h.resume();
+                if (h.done()) { return true; }
+                out->runner.store(std::thread::id(), std::memory_order_relaxed);
+                if (SuspendHook* k = currentSuspendHook()) { k->beforeSuspend(); }
+                if (yielded) {
+                    yielded = false;
+                    state.store(kQueued, std::memory_order_release);
+                    wakeups->push(index);
+                    return false;
+                }
+                int s = kRunning;
+                if (state.compare_exchange_strong(s, kSuspended, std::memory_order_acq_rel)) { return false; }
+                state.store(kRunning, std::memory_order_relaxed);
+                out->runner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            }
+        }
+
+        void finish(bool& changed) {
+            std::exception_ptr e = h.promise().error;
+            destroyFrame();
+            if (e) {
+                out->value.reset();
+                std::rethrow_exception(e);
+            }
+            changed = !out->value.equals(prev);
+            prev.reset();
+            out->publish();
+        }
+
+        void destroyFrame() {
+            h.destroy();
+            h = nullptr;
+            awaiting = nullptr;
+            yielded = false;
+            state.store(kIdle, std::memory_order_relaxed);
+            out->suspendable.store(false, std::memory_order_release);
         }
     };
+#endif
 
-    template <class Callable, class A1, class A2>
-    struct Task2 : ITaskBase, ResultCellAny::ITask {
-        Callable fn;
-        ArgWrap<A1> a1;
-        ArgWrap<A2> a2;
+    void recordDep(size_t v, ResultCellAny* c) {
+        if (!c) { return; }
+        if (c->graph != graphId_) {
+            external_.push_back(c);
+            return;
+        }
+        for (size_t k = depBegin_[v]; k < depIndex_.size(); ++k) {
+            if (depIndex_[k] == c->index) { return; }
+        }
+        depIndex_.push_back(c->index);
+    }
+
+    template <class Task, class... Args>
+    TaskId emplaceTask(Args&&... args) {
         std::shared_ptr<ResultCellAny> out;
+        Task* t;
+        if (taskArena_) {
+            out = std::shared_ptr<ResultCellAny>(cells_, cells_->create<ResultCellAny>());
+            t = taskArena_->create<Task>(std::forward<Args>(args)..., out);
+            out->producer = std::shared_ptr<ResultCellAny::ITask>(taskArena_, t);
+        } else {
+            out = std::make_shared<ResultCellAny>();
+            auto owned = std::make_shared<Task>(std::forward<Args>(args)..., out);
+            t = owned.get();
+            out->producer = owned;
+            owned_.push_back(std::move(owned));
+        }
+        out->graph = graphId_;
+        out->index = tasks_.size();
+        tasks_.push_back(t);
+        dirty_.push_back(0);
+        t->forEachDep([&](ResultCellAny* c) { recordDep(out->index, c); });
+        depBegin_.push_back(depIndex_.size());
+        return TaskId(std::move(out));
+    }
 
-        Task2(Callable f, A1 x1, A2 x2, std::shared_ptr<ResultCellAny> o)
-            : fn(std::move(f)), a1(std::move(x1)), a2(std::move(x2)), out(std::move(o)) {}
+    void prepare(bool preResolveExternalDeps, std::vector<size_t>& indeg) {
+        if (preResolveExternalDeps) {
+            for (ResultCellAny* c : external_) {
+                if (!c->ready.load(std::memory_order_acquire)) { c->ensureReady(); }
+            }
+        }
 
-        void execute() override {
-            if (out->ready) { return; }
-            out->value = Any(fn(a1.get(), a2.get()));
-            out->ready = true;
+        const size_t n = tasks_.size();
+        if (succBegin_.size() != n + 1) {
+            succBegin_.assign(n + 1, 0);
+            for (size_t u : depIndex_) { ++succBegin_[u + 1]; }
+            for (size_t i = 0; i < n; ++i) { succBegin_[i + 1] += succBegin_[i]; }
+            succIndex_.resize(depIndex_.size());
+            std::vector<size_t> fill(succBegin_.begin(), succBegin_.end() - 1);
+            for (size_t v = 0; v < n; ++v) {
+                for (size_t k = depBegin_[v]; k < depBegin_[v + 1]; ++k) {
+                    succIndex_[fill[depIndex_[k]]++] = v;
+                }
+            }
+        }
+
+        indeg.resize(n);
+        for (size_t v = 0; v < n; ++v) { indeg[v] = depBegin_[v + 1] - depBegin_[v]; }
+    }
+
+    size_t indexOf(const TaskId& id) const {
+        if (!id.out || id.out->graph != graphId_) { throw std::logic_error("task belongs to another graph"); }
+        return id.out->index;
+    }
+
+    double estimate(size_t v) const { return cost_[v] >= 0 ? cost_[v] : learned_[v]; }
+
+    void rankTasks() {
+        const size_t n = tasks_.size();
+        cost_.resize(n, -1.0);
+        learned_.resize(n, -1.0);
+        priority_.resize(n, 0.0);
+        sample_.assign(n, 0);
+        rank_.resize(n);
+        double known = 0;
+        size_t count = 0;
+        for (size_t v = 0; v < n; ++v) {
+            if (estimate(v) >= 0) {
+                known += estimate(v);
+                ++count;
+            }
+        }
+        const double fallback = count ? known / count : 1.0;
+        for (size_t v = n; v-- > 0;) {
+            double r = 0;
+            for (size_t k = succBegin_[v]; k < succBegin_[v + 1]; ++k) { r = std::max(r, rank_[succIndex_[k]]); }
+            rank_[v] = (estimate(v) >= 0 ? estimate(v) : fallback) + r;
+        }
+    }
+
+    bool refresh(size_t u, bool dirty, bool& changed) {
+        changed = false;
+        if (!tasks_[u]->ready()) { return tasks_[u]->run(changed); }
+        return !dirty || tasks_[u]->recompute(changed);
+    }
+
+    std::uint64_t traceNow() const {
+        return static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart_).count());
+    }
+
+    void traceBegin(size_t workers) {
+        trace_.workers = workers;
+        trace_.wallNs = trace_.busyNs = trace_.criticalNs = 0;
+        trace_.criticalPath.clear();
+        trace_.tasks.assign(tasks_.size(), TaskTrace{});
+        for (size_t i = 0; i < tasks_.size(); ++i) {
+            trace_.tasks[i].task = i;
+            trace_.tasks[i].startNs = UINT64_MAX;
         }
+        traceStart_ = std::chrono::steady_clock::now();
+    }
+
+    void traceReady(size_t v) { trace_.tasks[v].readyNs = traceNow(); }
 
-        bool ready() const override { return out->ready; }
-        std::shared_ptr<ResultCellAny> output() const override { return out; }
+    struct SliceClock final : SuspendHook {
+        TTaskScheduler* s;
+        size_t worker;
+        size_t u = 0;
+        std::uint64_t begin = 0;
 
-        std::vector<std::shared_ptr<ResultCellAny>> deps() const override {
-            std::vector<std::shared_ptr<ResultCellAny>> d;
-            if (auto c1 = a1.depCell()) { d.push_back(std::move(c1)); }
-            if (auto c2 = a2.depCell()) { d.push_back(std::move(c2)); }
-            return d;
+        SliceClock(TTaskScheduler* sched, size_t w) : s(sched), worker(w) {}
+
+        void beforeSuspend() override {
+            std::uint64_t end = s->traceNow();
+            s->timeSlice(u, worker, begin, end, false, true);
+            begin = end;
         }
     };
 
+    void timeSlice(size_t u, size_t worker, std::uint64_t begin, std::uint64_t end, bool done, bool ran) {
+        if (tracing_) { traceSlice(u, worker, begin, end, done, ran); }
+        if (readyOrder_ == ReadyOrder::CriticalPath) {
+            sample_[u] += end - begin;
+            if (!done) { return; }
+            if (ran) {
+                double ns = static_cast<double>(sample_[u]);
+                learned_[u] = learned_[u] < 0 ? ns : 0.5 * (learned_[u] + ns);
+            }
+            sample_[u] = 0;
+        }
+    }
+
+    void traceSlice(size_t u, size_t worker, std::uint64_t begin, std::uint64_t end, bool done, bool ran) {
+        TaskTrace& t = trace_.tasks[u];
+        t.startNs = std::min(t.startNs, begin);
+        t.activeNs += end - begin;
+        if (!done) { return; }
+        t.endNs = end;
+        t.worker = worker;
+        t.ran = ran;
+        t.resultBytes = ran ? tasks_[u]->result().value.bytes() : 0;
+        if (!ran) {
+            t.startNs = begin;
+            t.activeNs = 0;
+        }
+    }
+
+    void traceEnd() {
+        trace_.wallNs = traceNow();
+        const size_t n = trace_.tasks.size();
+        std::vector<std::uint64_t> dist(n);
+        std::vector<size_t> via(n, SIZE_MAX);
+        size_t last = SIZE_MAX;
+        for (size_t v = 0; v < n; ++v) {
+            TaskTrace& t = trace_.tasks[v];
+            if (t.startNs == UINT64_MAX) { t.startNs = t.endNs = t.readyNs; }
+            trace_.busyNs += t.activeNs;
+            for (size_t k = depBegin_[v]; k < depBegin_[v + 1]; ++k) {
+                size_t u = depIndex_[k];
+                if (dist[u] > dist[v]) {
+                    dist[v] = dist[u];
+                    via[v] = u;
+                }
+            }
+            dist[v] += t.activeNs;
+            if (dist[v] > 0 && (last == SIZE_MAX || dist[v] > dist[last])) { last = v; }
+        }
+        if (last == SIZE_MAX) { return; }
+        trace_.criticalNs = dist[last];
+        for (size_t v = last; v != SIZE_MAX; v = via[v]) { trace_.criticalPath.push_back(v); }
+        std::reverse(trace_.criticalPath.begin(), trace_.criticalPath.end());
+    }
+
+    static void writeMicros(std::ostream& os, std::uint64_t ns) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                      static_cast<unsigned long long>(ns % 1000));
+        os << buf;
+    }
+
     template <class C>
     static C* objPtr(C& r) { return &r; }
     template <class C>
@@ -238,73 +1209,118 @@ public:
         bool ok = false;
         std::vector<size_t> order;
         std::vector<size_t> stuck;
+        size_t executed = 0;
     };
 
-    TTaskScheduler() = default;
+    struct Cost {
+        double ns;
+    };
+
+    struct Arena {
+        size_t blockBytes = size_t(256) << 10;
+        size_t reserveTasks = 0;
+    };
+
+    TTaskScheduler() : graphId_(nextGraphId()) {}
+
+    explicit TTaskScheduler(Arena a)
+        : graphId_(nextGraphId()),
+          cells_(std::make_shared<GraphArena>(a.blockBytes)),
+          taskArena_(std::make_shared<GraphArena>(a.blockBytes)) {
+        tasks_.reserve(a.reserveTasks);
+        depBegin_.reserve(a.reserveTasks + 1);
+    }
 
     size_t size() const { return tasks_.size(); }
 
-    template <class Callable>
-    TaskId add(Callable fn) {
-        auto out = std::make_shared<ResultCellAny>();
-        auto t = std::make_shared<Task0<Callable>>(std::move(fn), out);
-        bindProducer(out, t);
-        tasks_.push_back(t);
-        return TaskId(out);
+    void setTracing(bool on) { tracing_ = on; }
+
+    const ExecTrace& lastTrace() const { return trace_; }
+
+    void writeChromeTrace(std::ostream& os) const {
+        std::vector<char> critical(trace_.tasks.size());
+        for (size_t v : trace_.criticalPath) { critical[v] = 1; }
+        os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"TTaskScheduler\"}}";
+        for (size_t w = 0; w < trace_.workers; ++w) {
+            os << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << w
+               << ",\"args\":{\"name\":\"worker " << w << "\"}}";
+        }
+        for (const TaskTrace& t : trace_.tasks) {
+            if (!t.ran) { continue; }
+            os << ",\n{\"name\":\"task " << t.task << "\",\"cat\":\"" << (critical[t.task] ? "critical" : "task")
+               << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t.worker << ",\"ts\":";
+            writeMicros(os, t.startNs);
+            os << ",\"dur\":";
+            writeMicros(os, t.durationNs());
+            os << ",\"args\":{\"wait_us\":";
+            writeMicros(os, t.waitNs());
+            os << ",\"active_us\":";
+            writeMicros(os, t.activeNs);
+            os << ",\"result_bytes\":" << t.resultBytes << "}}";
+        }
+        os << "\n]}\n";
     }
 
-    template <class Callable, class A1>
-    TaskId add(Callable fn, A1 a1) {
-        auto out = std::make_shared<ResultCellAny>();
-        auto t = std::make_shared<Task1<Callable, A1>>(std::move(fn), std::move(a1), out);
-        bindProducer(out, t);
-        tasks_.push_back(t);
-        return TaskId(out);
+    void writeChromeTrace(const std::string& path) const {
+        std::ofstream f(path);
+        if (!f) { throw std::runtime_error("cannot open trace file: " + path); }
+        writeChromeTrace(f);
+        if (!f) { throw std::runtime_error("cannot write trace file: " + path); }
     }
 
-    template <class Callable, class A1, class A2>
-    TaskId add(Callable fn, A1 a1, A2 a2) {
-        auto out = std::make_shared<ResultCellAny>();
-        auto t = std::make_shared<Task2<Callable, A1, A2>>(std::move(fn), std::move(a1), std::move(a2), out);
-        bindProducer(out, t);
-        tasks_.push_back(t);
-        return TaskId(out);
+    void markDirty(const TaskId& id) { dirty_[indexOf(id)] = 1; }
+
+    void setReadyOrder(ReadyOrder order) { readyOrder_ = order; }
+
+    void setCost(const TaskId& id, double ns) {
+        size_t v = indexOf(id);
+        cost_.resize(tasks_.size(), -1.0);
+        cost_[v] = ns;
     }
 
-    template <class C, class R, class Obj>
-    TaskId add(R (C::*pmf)(), Obj obj) {
-        auto bound = [pmf, obj]() -> R { return (const_cast<C*>(objPtr(obj))->*pmf)(); };
-        return add(bound);
+    void setPriority(const TaskId& id, double priority) {
+        size_t v = indexOf(id);
+        priority_.resize(tasks_.size(), 0.0);
+        priority_[v] = priority;
     }
 
-    template <class C, class R, class Obj>
-    TaskId add(R (C::*pmf)() const, Obj obj) {
-        auto bound = [pmf, obj]() -> R { return (objPtr(obj)->*pmf)(); };
-        return add(bound);
+    double costEstimate(const TaskId& id) const {
+        size_t v = indexOf(id);
+        if (v < cost_.size() && cost_[v] >= 0) { return cost_[v]; }
+        return v < learned_.size() ? learned_[v] : -1.0;
     }
 
-    template <class C, class R, class Obj, class P1, class A1>
-    TaskId add(R (C::*pmf)(P1), Obj obj, A1 a1) {
-        auto bound = [pmf, obj](P1 x) -> R { return (const_cast<C*>(objPtr(obj))->*pmf)(x); };
-        return add(bound, std::move(a1));
+    template <class Callable, class... As>
+    TaskId add(Callable fn, As... as) {
+#ifdef TS_HAVE_COROUTINES
+        using R = std::invoke_result_t<Callable&, decltype(std::declval<const ArgWrap<As>&>().get())...>;
+        if constexpr (IsCoTask<R>::value) {
+            return emplaceTask<CoTaskN<Callable, As...>>(wakeups_.get(), std::move(fn), std::move(as)...);
+        } else
+#endif
+        {
+            return emplaceTask<TaskN<Callable, As...>>(std::move(fn), std::move(as)...);
+        }
     }
 
-    template <class C, class R, class Obj, class P1, class A1>
-    TaskId add(R (C::*pmf)(P1) const, Obj obj, A1 a1) {
-        auto bound = [pmf, obj](P1 x) -> R { return (objPtr(obj)->*pmf)(x); };
-        return add(bound, std::move(a1));
+    template <class Callable, class... As>
+    TaskId add(Cost cost, Callable fn, As... as) {
+        TaskId id = add(std::move(fn), std::move(as)...);
+        setCost(id, cost.ns);
+        return id;
     }
 
-    template <class C, class R, class Obj, class P1, class P2, class A1, class A2>
-    TaskId add(R (C::*pmf)(P1, P2), Obj obj, A1 a1, A2 a2) {
-        auto bound = [pmf, obj](P1 x, P2 y) -> R { return (const_cast<C*>(objPtr(obj))->*pmf)(x, y); };
-        return add(bound, std::move(a1), std::move(a2));
+    template <class C, class R, class Obj, class... Ps, class... As>
+    TaskId add(R (C::*pmf)(Ps...), Obj obj, As... as) {
+        auto bound = [pmf, obj](Ps... xs) -> R { return (const_cast<C*>(objPtr(obj))->*pmf)(xs...); };
+        return add(bound, std::move(as)...);
     }
 
-    template <class C, class R, class Obj, class P1, class P2, class A1, class A2>
-    TaskId add(R (C::*pmf)(P1, P2) const, Obj obj, A1 a1, A2 a2) {
-        auto bound = [pmf, obj](P1 x, P2 y) -> R { return (objPtr(obj)->*pmf)(x, y); };
-        return add(bound, std::move(a1), std::move(a2));
+    template <class C, class R, class Obj, class... Ps, class... As>
+    TaskId add(R (C::*pmf)(Ps...) const, Obj obj, As... as) {
+        auto bound = [pmf, obj](Ps... xs) -> R { return (objPtr(obj)->*pmf)(xs...); };
+        return add(bound, std::move(as)...);
     }
 
     template <class T>
@@ -314,78 +1330,58 @@ public:
     const T& getResult(const TaskId& id) const { Future<T> f(id.out); return f.get(); }
 
     TopoExec executeTopologicallyDetailed(bool preResolveExternalDeps = true) {
-        std::unordered_map<const void*, size_t> indexByPtr;
-        indexByPtr.reserve(tasks_.size());
-        for (size_t i = 0; i < tasks_.size(); ++i) {
-            indexByPtr[tasks_[i].get()] = i;
-        }
-
-        std::vector<std::vector<size_t>> adj(tasks_.size());
-        std::vector<size_t> indeg(tasks_.size(), 0);
-
-        for (size_t v = 0; v < tasks_.size(); ++v) {
-            auto d = tasks_[v]->deps();
-            std::unordered_set<size_t> seen;
-            for (auto& depCell : d) {
-                if (!depCell) { continue; }
-
-                if (preResolveExternalDeps) {
-                    auto prod0 = depCell->producer.lock();
-                    if (!prod0) {
-                        if (!depCell->ready) { depCell->ensureReady(); }
-                        continue;
-                    }
-                    auto base0 = dynamic_cast<ITaskBase*>(prod0.get());
-                    if (!base0) {
-                        if (!depCell->ready) { depCell->ensureReady(); }
-                        continue;
-                    }
-                    if (!indexByPtr.count(base0)) {
-                        if (!depCell->ready) { depCell->ensureReady(); }
-                        continue;
-                    }
-                }
-
-                auto prod = depCell->producer.lock();
-                if (!prod) { continue; }
-                auto raw = dynamic_cast<ITaskBase*>(prod.get());
-                auto it = indexByPtr.find(raw);
-                if (it == indexByPtr.end()) { continue; }
-                size_t u = it->second;
-                if (seen.insert(u).second) {
-                    adj[u].push_back(v);
-                    ++indeg[v];
-                }
-            }
-        }
-
-        std::queue<size_t> q;
+        std::vector<size_t> indeg;
+        prepare(preResolveExternalDeps, indeg);
+        if (tracing_) { traceBegin(1); }
+        const bool ranked = readyOrder_ == ReadyOrder::CriticalPath;
+        if (ranked) { rankTasks(); }
+        const bool timed = tracing_ || ranked;
+
+        RankLess less{priority_.data(), rank_.data()};
+        std::deque<size_t> q;
+        auto push = [&](size_t v) {
+            q.push_back(v);
+            if (ranked) { std::push_heap(q.begin(), q.end(), less); }
+        };
         for (size_t i = 0; i < indeg.size(); ++i) {
-            if (indeg[i] == 0) { q.push(i); }
+            if (indeg[i] == 0) { push(i); }
         }
 
         TopoExec res;
         res.order.reserve(tasks_.size());
 
         while (!q.empty()) {
-            size_t u = q.front();
-            q.pop();
+            if (ranked) { std::pop_heap(q.begin(), q.end(), less); }
+            size_t u = ranked ? q.back() : q.front();
+            if (ranked) { q.pop_back(); } else { q.pop_front(); }
             res.order.push_back(u);
 
-            if (!tasks_[u]->ready()) {
-                tasks_[u]->execute();
+            bool dirty = dirty_[u] != 0;
+            bool changed = false;
+            std::uint64_t begin = timed ? traceNow() : 0;
+            if (!refresh(u, dirty, changed)) {
+                tasks_[u]->cancel();
+                throw std::logic_error("coroutine task suspended outside executeParallel");
             }
+            if (timed) { timeSlice(u, 0, begin, traceNow(), true, changed || dirty); }
+            if (changed || dirty) { ++res.executed; }
+            dirty_[u] = 0;
 
-            for (size_t v : adj[u]) {
+            for (size_t k = succBegin_[u]; k < succBegin_[u + 1]; ++k) {
+                size_t v = succIndex_[k];
+                if (changed) { dirty_[v] = 1; }
                 if (indeg[v] > 0) {
                     --indeg[v];
                     if (indeg[v] == 0) {
-                        q.push(v);
+                        if (tracing_) { traceReady(v); }
+                        push(v);
                     }
                 }
             }
         }
 
+        if (tracing_) { traceEnd(); }
+
         if (res.order.size() != tasks_.size()) {
             res.ok = false;
             for (size_t i = 0; i < indeg.size(); ++i) {
@@ -398,6 +1394,130 @@ public:
         return res;
     }
 
+    TopoExec executeParallel(size_t n_threads = 0, bool preResolveExternalDeps = true) {
+        std::vector<size_t> indeg0;
+        prepare(preResolveExternalDeps, indeg0);
+
+        if (n_threads == 0) { n_threads = std::max<size_t>(1, std::thread::hardware_concurrency()); }
+        if (tracing_) { traceBegin(n_threads); }
+        const bool ranked = readyOrder_ == ReadyOrder::CriticalPath;
+        if (ranked) { rankTasks(); }
+        const bool timed = tracing_ || ranked;
+
+        const size_t n = tasks_.size();
+        std::vector<std::atomic<size_t>> indeg(n);
+        std::vector<std::atomic<bool>> dirty(n);
+        std::vector<WorkDeque> queues(n_threads);
+        RankLess less{priority_.data(), rank_.data()};
+        if (ranked) {
+            for (WorkDeque& q : queues) { q.order(&less); }
+        }
+        std::atomic<size_t> pending{0};
+        std::atomic<size_t> executed{0};
+        size_t roots = 0;
+        for (size_t i = 0; i < n; ++i) {
+            indeg[i].store(indeg0[i], std::memory_order_relaxed);
+            dirty[i].store(dirty_[i] != 0, std::memory_order_relaxed);
+            if (indeg0[i] == 0) { queues[roots++ % n_threads].push(i); }
+        }
+        pending.store(roots, std::memory_order_relaxed);
+
+        TopoExec res;
+        res.order.resize(n);
+        std::atomic<size_t> pos{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        IdleGate idle;
+        for (WorkDeque& q : queues) { q.notify(&idle); }
+        wakeups_->notify(&idle);
+
+        auto worker = [&](size_t w) {
+            std::uint64_t& graph = currentParallelGraph();
+            std::uint64_t outer = graph;
+            graph = graphId_;
+            SliceClock clock(this, w);
+            SuspendHook*& hook = currentSuspendHook();
+            SuspendHook* outerHook = hook;
+            hook = timed ? &clock : nullptr;
+            size_t u = 0;
+            while (pending.load(std::memory_order_acquire) != 0 && !failed.load(std::memory_order_relaxed)) {
+                std::uint64_t seen = idle.epoch();
+                bool resumed = false;
+                if (!queues[w].pop(u) && !(resumed = wakeups_->steal(u)) && !steal(queues, w, u)) {
+                    if (pending.load(std::memory_order_acquire) != 0 && !failed.load(std::memory_order_relaxed)) {
+                        idle.wait(seen);
+                    }
+                    continue;
+                }
+                if (!resumed) { res.order[pos.fetch_add(1, std::memory_order_relaxed)] = u; }
+                bool changed = false;
+                bool done = true;
+                try {
+                    bool d = dirty[u].load(std::memory_order_relaxed);
+                    clock.u = u;
+                    clock.begin = timed ? traceNow() : 0;
+                    done = refresh(u, d, changed);
+                    if (timed && done) { timeSlice(u, w, clock.begin, traceNow(), true, changed || d); }
+                    if (done && (changed || d)) { executed.fetch_add(1, std::memory_order_relaxed); }
+                    if (done) { dirty[u].store(false, std::memory_order_relaxed); }
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error) { error = std::current_exception(); }
+                        failed.store(true, std::memory_order_relaxed);
+                    }
+                    idle.notify(true);
+                }
+                if (!done) { continue; }
+                if (!failed.load(std::memory_order_relaxed)) {
+                    for (size_t k = succBegin_[u]; k < succBegin_[u + 1]; ++k) {
+                        size_t v = succIndex_[k];
+                        if (changed) { dirty[v].store(true, std::memory_order_relaxed); }
+                        if (indeg[v].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                            if (tracing_) { traceReady(v); }
+                            pending.fetch_add(1, std::memory_order_relaxed);
+                            queues[w].push(v);
+                        }
+                    }
+                }
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) { idle.notify(true); }
+            }
+            hook = outerHook;
+            graph = outer;
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(n_threads - 1);
+        for (size_t w = 1; w < n_threads; ++w) { threads.emplace_back(worker, w); }
+        worker(0);
+        for (auto& t : threads) { t.join(); }
+        wakeups_->notify(nullptr);
+
+        for (size_t i = 0; i < n; ++i) { dirty_[i] = dirty[i].load(std::memory_order_relaxed); }
+        res.executed = executed.load();
+
+        if (error) {
+            for (ITaskBase* t : tasks_) { t->cancel(); }
+            wakeups_->clear();
+            std::rethrow_exception(error);
+        }
+
+        if (tracing_) { traceEnd(); }
+
+        res.order.resize(pos.load());
+        if (res.order.size() != n) {
+            res.ok = false;
+            for (size_t i = 0; i < n; ++i) {
+                if (indeg[i].load(std::memory_order_relaxed) != 0) { res.stuck.push_back(i); }
+            }
+            return res;
+        }
+
+        res.ok = true;
+        return res;
+    }
+
     bool executeTopologically() {
         return executeTopologicallyDetailed().ok;
     }